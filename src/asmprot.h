@@ -19,6 +19,111 @@ convolver_sse2_convolve_add(void *input_cbuf,
                             void *output_cbuf,
                             int loop_counter);
 
+void
+convolver_sse_td_fir(void *input,
+                     void *coeffs,
+                     int n_coeffs,
+                     float scale,
+                     void *output,
+                     int n_samples);
+
+void
+convolver_sse2_td_fir(void *input,
+                      void *coeffs,
+                      int n_coeffs,
+                      double scale,
+                      void *output,
+                      int n_samples);
+
+void
+convolver_sse_td_mixnscale(void *inputs[],
+                           void *output,
+                           double scales[],
+                           int n_bufs,
+                           int n_samples);
+
+void
+convolver_sse2_td_mixnscale(void *inputs[],
+                            void *output,
+                            double scales[],
+                            int n_bufs,
+                            int n_samples);
+
+/* sample format conversion, returns the number of samples converted */
+int
+convolver_sse2_raw2realf(void *realbuf,
+                         void *rawbuf,
+                         int bytes,
+                         int isfloat,
+                         int spacing,
+                         int swap,
+                         int n_samples);
+
+int
+convolver_sse2_raw2reald(void *realbuf,
+                         void *rawbuf,
+                         int bytes,
+                         int isfloat,
+                         int spacing,
+                         int swap,
+                         int n_samples);
+
+struct bfoverflow;
+
+int
+convolver_sse2_real2rawf(void *rawbuf,
+                         void *realbuf,
+                         int bits,
+                         int bytes,
+                         int isfloat,
+                         int spacing,
+                         int swap,
+                         int n_samples,
+                         struct bfoverflow *overflow,
+                         double *peak,
+                         int *denormal);
+
+int
+convolver_sse2_real2rawd(void *rawbuf,
+                         void *realbuf,
+                         int bits,
+                         int bytes,
+                         int isfloat,
+                         int spacing,
+                         int swap,
+                         int n_samples,
+                         struct bfoverflow *overflow,
+                         double *peak,
+                         int *denormal);
+
+int
+convolver_sse2_real2rawf_hp_tpdf(void *rawbuf,
+                                 void *realbuf,
+                                 int bits,
+                                 int bytes,
+                                 int spacing,
+                                 int swap,
+                                 int n_samples,
+                                 const float noise[],
+                                 float err[2],
+                                 struct bfoverflow *overflow,
+                                 double *peak,
+                                 int *denormal);
+
+int
+convolver_sse2_real2rawd_hp_tpdf(void *rawbuf,
+                                 void *realbuf,
+                                 int bits,
+                                 int bytes,
+                                 int spacing,
+                                 int swap,
+                                 int n_samples,
+                                 const double noise[],
+                                 double err[2],
+                                 struct bfoverflow *overflow,
+                                 double *peak,
+                                 int *denormal);
+
 void
 convolver_3dnow_convolve_add(void *input_cbuf,
                              void *coeffs,
@@ -111,6 +111,8 @@ static struct bflex *logic_params[BF_MAXMODULES];
 static struct bflex *config_params;
 static int config_params_pos;
 static bool has_defaults = false;
+static void **fuse_td = NULL;
+static int *fuse_td_len = NULL;
 
 #define FROM_DB(db) (pow(10, (db) / 20.0))
 
@@ -260,7 +262,6 @@ filter_length: 65536;       # length of filters\n\
 config_file: \"$XDG_CONFIG_HOME/BruteFIR/brutefir.conf\"; # standard location of main config file\n\
 overflow_warnings: true;    # echo warnings to stderr if overflow occurs\n\
 show_progress: true;        # echo filtering progress to stderr\n\
-max_dither_table_size: 0;   # maximum size in bytes of precalculated dither\n\
 allow_poll_mode: false;     # allow use of input poll mode\n"
 #ifndef SINGLE_MOD_PATH
 "modules_path: \".\";          # extra path where to find BruteFIR modules\n"
@@ -269,7 +270,11 @@ allow_poll_mode: false;     # allow use of input poll mode\n"
 powersave: false;           # pause filtering when input is zero\n\
 lock_memory: true;          # try to lock memory if realtime prio is set\n\
 sdf_length: -1;             # subsample filter half length in samples\n\
-safety_limit: 20;           # if non-zero max dB in output before aborting\n"
+safety_limit: 20;           # if non-zero max dB in output before aborting\n\
+direct_fir_taps: 0;         # max taps for time-domain filtering of short coeffs\n\
+flush_denormals: true;      # flush denormals to zero in filter processes\n\
+sync_callback_io: false;    # filter callback I/O within the server callback\n\
+parallel_io: false;         # one thread per blocking I/O device\n"
 #ifdef CONVOLVER_NEEDS_CONFIGFILE
             "convolver_config: \"$XDG_CACHE_HOME/BruteFIR/brutefir_convolver_wisdom\"; # FFTW wisdom\n"
 #endif
@@ -315,6 +320,8 @@ filter {\n\
 \tprocess: -1;        # process index to run in (-1 means auto)\n\
 \tdelay: 0;           # predelay, in blocks\n\
 \tcrossfade: false;   # crossfade when coefficient is changed\n\
+\tpartition: 0;       # partition length in samples, 0 means filter length\n\
+\tmaxdelay: 0;        # extra blocks for delays without truncation\n\
 };\n\
 ", BF_SAMPLE_SLOTS, BF_SAMPLE_SLOTS);
 
@@ -595,6 +602,270 @@ parse_sample_format(struct sample_format *sf,
     return false;
 }
 
+/* filters which compute the same thing, and thus only need to be
+   evaluated once, as long as they are not changed at run-time */
+static bool
+cse_equal(struct filter *a,
+          struct filter *b)
+{
+    int n;
+
+    if (a->process != b->process ||
+        a->filter.n_channels[IN] != b->filter.n_channels[IN] ||
+        a->fctrl.coeff != b->fctrl.coeff ||
+        a->fctrl.delayblocks != b->fctrl.delayblocks)
+    {
+        return false;
+    }
+    for (n = 0; n < a->filter.n_channels[IN]; n++) {
+        if (a->filter.channels[IN][n] != b->filter.channels[IN][n] ||
+            a->fctrl.scale[IN][n] != b->fctrl.scale[IN][n])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool
+cse_candidate(const struct bffilter *filter)
+{
+    /* filters with state of their own besides the convolution, which are
+       connected to other filters, or with subsample delays folded into the
+       coefficients, are not merged */
+    return filter->n_channels[IN] > 0 &&
+        filter->n_filters[IN] == 0 &&
+        filter->n_filters[OUT] == 0 &&
+        !filter->crossfade &&
+        filter->partition == 0 &&
+        bfconf->sdfold_coeff[filter->intname] == -1;
+}
+
+static bool
+fuse_candidate(int n)
+{
+    struct bffilter *a, *b = &bfconf->filters[n];
+
+    if (b->n_channels[IN] != 0 || b->n_filters[IN] != 1 || b->crossfade) {
+        return false;
+    }
+    a = &bfconf->filters[b->filters[IN][0]];
+    return a->n_filters[OUT] == 1 && a->n_channels[OUT] == 0 &&
+        a->n_filters[IN] == 0 && !a->crossfade;
+}
+
+/* convolve two time-domain coefficient sets into one in the internal
+   format, returns NULL if it becomes too long */
+static void **
+fuse_coeffs(void *a,
+            int len_a,
+            void *b,
+            int len_b,
+            int *n_blocks)
+{
+    void *fa, *fb, *acc, **cbuf;
+    int n, len, blocklen;
+
+    len = len_a + len_b - 1;
+    if (len_a < 1 || len_b < 1 || len > bfconf->n_blocks * bfconf->filter_length) {
+        return NULL;
+    }
+    blocklen = 1 << log2_roof(len_a > len_b ? len_a : len_b);
+    /* one of the sets is scaled up to cancel the transform scaling of the
+       other */
+    fa = convolver_part_coeffs2cbuf(a, len_a, (double)(blocklen << 1), blocklen);
+    fb = convolver_part_coeffs2cbuf(b, len_b, 1.0, blocklen);
+    acc = emallocaligned(2 * blocklen * bfconf->realsize);
+    memset(acc, 0, 2 * blocklen * bfconf->realsize);
+    convolver_part_convolve_add(fa, fb, acc, blocklen);
+    convolver_part_freq2time(acc, blocklen);
+    *n_blocks = (len + bfconf->filter_length - 1) / bfconf->filter_length;
+    cbuf = emalloc(*n_blocks * sizeof(void *));
+    for (n = 0; n < *n_blocks; n++) {
+        cbuf[n] = convolver_coeffs2cbuf
+            (&((uint8_t *)acc)[n * bfconf->filter_length * bfconf->realsize],
+             len - n * bfconf->filter_length < bfconf->filter_length ?
+             len - n * bfconf->filter_length : bfconf->filter_length,
+             1.0,
+             NULL);
+    }
+    efree(fa);
+    efree(fb);
+    efree(acc);
+    return cbuf;
+}
+
+static void
+fuse_mark(int coeff)
+{
+    if (coeff < 0) {
+        return;
+    }
+    if (fuse_td == NULL) {
+        fuse_td = emalloc(bfconf->n_coeffs * sizeof(void *));
+        memset(fuse_td, 0, bfconf->n_coeffs * sizeof(void *));
+        fuse_td_len = emalloc(bfconf->n_coeffs * sizeof(int));
+        memset(fuse_td_len, 0, bfconf->n_coeffs * sizeof(int));
+    }
+    fuse_td_len[coeff] = -1;
+}
+
+/* adds a coefficient set after the ordinary ones, which cannot be selected
+   by the user */
+static int
+add_hidden_coeff(void **cbuf,
+                 int n_blocks)
+{
+    int k;
+
+    k = bfconf->n_coeffs + bfconf->n_fused_coeffs;
+    bfconf->coeffs_data = erealloc(bfconf->coeffs_data, (k + 1) * sizeof(void **));
+    bfconf->coeffs = erealloc(bfconf->coeffs, (k + 1) * sizeof(struct bfcoeff));
+    memset(&bfconf->coeffs[k], 0, sizeof(struct bfcoeff));
+    bfconf->coeffs_data[k] = cbuf;
+    bfconf->coeffs[k].n_blocks = n_blocks;
+    sprintf(bfconf->coeffs[k].name, "%d", k);
+    bfconf->coeffs[k].intname = k;
+    bfconf->n_fused_coeffs++;
+    return k;
+}
+
+static bool
+sdfold_candidate(int n)
+{
+    const struct bffilter *filter = &bfconf->filters[n];
+
+    return filter->n_filters[IN] == 0 &&
+        filter->n_filters[OUT] == 0 &&
+        !filter->crossfade &&
+        filter->partition == 0 &&
+        bfconf->initfctrl[n].coeff >= 0;
+}
+
+static void *
+sdfold_convolve_taps(void *a,
+                     int len_a,
+                     void *b,
+                     int len_b)
+{
+    void *c;
+    int n, i;
+
+    c = emalloc((len_a + len_b - 1) * bfconf->realsize);
+    memset(c, 0, (len_a + len_b - 1) * bfconf->realsize);
+    for (n = 0; n < len_a; n++) {
+        for (i = 0; i < len_b; i++) {
+            if (bfconf->realsize == 4) {
+                ((float *)c)[n+i] += ((float *)a)[n] * ((float *)b)[i];
+            } else {
+                ((double *)c)[n+i] += ((double *)a)[n] * ((double *)b)[i];
+            }
+        }
+    }
+    return c;
+}
+
+/* fold the initial subsample delays of channels into the coefficient sets
+   of the filters using them, so the channels need no delay filtering of
+   their own. This requires that all filters using a channel can do so,
+   with the same subsample delay on all channels on that side. */
+static void
+sdfold_init(void)
+{
+    const struct bffilter *filter;
+    bool changed, fold, same;
+    void *taps, *s, *t;
+    int n, i, k, ch, n_fold, n_taps, len;
+
+    bfconf->sdfold_coeff = emalloc(bfconf->n_filters * sizeof(int));
+    for (n = 0; n < bfconf->n_filters; n++) {
+        bfconf->sdfold_coeff[n] = -1;
+    }
+    FOR_IN_AND_OUT {
+        bfconf->sdfold[IO] = emalloc(bfconf->n_channels[IO] * sizeof(bool));
+        for (n = 0; n < bfconf->n_channels[IO]; n++) {
+            bfconf->sdfold[IO][n] = bfconf->use_subdelay[IO] &&
+                bfconf->subdelay[IO][n] != BF_UNDEFINED_SUBDELAY;
+        }
+    }
+    if (!bfconf->use_subdelay[IN] && !bfconf->use_subdelay[OUT]) {
+        return;
+    }
+    do {
+        changed = false;
+        for (n = 0; n < bfconf->n_filters; n++) {
+            filter = &bfconf->filters[n];
+            fold = sdfold_candidate(n);
+            if (fold) {
+                k = bfconf->initfctrl[n].coeff;
+                /* room for the delay filters of both sides is required, and
+                   sets run in the time-domain are better left as is */
+                fold = fuse_td != NULL && fuse_td[k] != NULL &&
+                    bfconf->coeffs_dirac_pos[k] < 0 &&
+                    bfconf->coeffs_td[k] == NULL &&
+                    fuse_td_len[k] + 4 * bfconf->sdf_length <=
+                    bfconf->n_blocks * bfconf->filter_length;
+            }
+            FOR_IN_AND_OUT {
+                n_fold = 0;
+                same = true;
+                for (i = 0; i < filter->n_channels[IO]; i++) {
+                    ch = filter->channels[IO][i];
+                    if (!bfconf->sdfold[IO][ch]) {
+                        continue;
+                    }
+                    if (n_fold > 0 &&
+                        bfconf->subdelay[IO][ch] != bfconf->subdelay[IO][filter->channels[IO][0]])
+                    {
+                        same = false;
+                    }
+                    n_fold++;
+                }
+                if (n_fold > 0 &&
+                    (!fold || !same || n_fold != filter->n_channels[IO]))
+                {
+                    for (i = 0; i < filter->n_channels[IO]; i++) {
+                        bfconf->sdfold[IO][filter->channels[IO][i]] = false;
+                    }
+                    changed = true;
+                }
+            }
+        }
+    } while (changed);
+
+    for (n = 0; n < bfconf->n_filters; n++) {
+        filter = &bfconf->filters[n];
+        taps = NULL;
+        n_taps = 0;
+        FOR_IN_AND_OUT {
+            if (filter->n_channels[IO] == 0 ||
+                !bfconf->sdfold[IO][filter->channels[IO][0]])
+            {
+                continue;
+            }
+            s = delay_subsample_filter(bfconf->subdelay[IO][filter->channels[IO][0]], &len);
+            if (taps == NULL) {
+                taps = s;
+                n_taps = len;
+            } else {
+                t = sdfold_convolve_taps(taps, n_taps, s, len);
+                efree(taps);
+                efree(s);
+                taps = t;
+                n_taps += len - 1;
+            }
+        }
+        if (taps == NULL) {
+            continue;
+        }
+        k = bfconf->initfctrl[n].coeff;
+        s = fuse_coeffs(fuse_td[k], fuse_td_len[k], taps, n_taps, &len);
+        efree(taps);
+        bfconf->sdfold_coeff[n] = add_hidden_coeff(s, len);
+        bfconf->use_sdfold = true;
+    }
+}
+
 static void
 free_params(struct bflex *bflex)
 {
@@ -1136,6 +1407,24 @@ parse_filter(bool parse_default,
                 get_token(BOOLEAN);
                 filter->filter.crossfade = yylval.boolean;
                 get_token(EOS);
+            } else if (strcmp(yylval.field, "partition") == 0) {
+                field_repeat_test(&bitset, 8);
+                get_token(REAL);
+                filter->filter.partition = make_integer(yylval.real);
+                if (filter->filter.partition < 0) {
+                    parse_error("invalid partition.\n");
+                }
+                /* checked against filter length when all configuration has
+                   been read */
+                get_token(EOS);
+            } else if (strcmp(yylval.field, "maxdelay") == 0) {
+                field_repeat_test(&bitset, 9);
+                get_token(REAL);
+                filter->filter.maxdelay = make_integer(yylval.real);
+                if (filter->filter.maxdelay < 0) {
+                    parse_error("invalid maxdelay.\n");
+                }
+                get_token(EOS);
             } else {
                 unrecognised_token("filter field", yylval.field);
             }
@@ -1552,8 +1841,8 @@ parse_setting(char field[],
         get_token(EOS);
     } else if (strcmp(field, "max_dither_table_size") == 0) {
         field_repeat_test(repeat_bitset, 6);
+        pinfo("Warning: \"max_dither_table_size\" setting is deprecated.\n");
         get_token(REAL);
-        bfconf->max_dither_table_size = make_integer(yylval.real);
         get_token(EOS);
     } else if (strcmp(field, "filter_length") == 0) {
         field_repeat_test(repeat_bitset, 7);
@@ -1707,6 +1996,29 @@ parse_setting(char field[],
             exit(BF_EXIT_INVALID_CONFIG);
         }
         get_token(EOS);
+    } else if (strcmp(field, "direct_fir_taps") == 0) {
+        field_repeat_test(repeat_bitset, 19);
+        get_token(REAL);
+        bfconf->direct_fir_taps = make_integer(yylval.real);
+        if (bfconf->direct_fir_taps < 0) {
+            parse_error("invalid direct_fir_taps.\n");
+        }
+        get_token(EOS);
+    } else if (strcmp(field, "flush_denormals") == 0) {
+        field_repeat_test(repeat_bitset, 20);
+        get_token(BOOLEAN);
+        bfconf->flush_denormals = yylval.boolean;
+        get_token(EOS);
+    } else if (strcmp(field, "sync_callback_io") == 0) {
+        field_repeat_test(repeat_bitset, 21);
+        get_token(BOOLEAN);
+        bfconf->sync_callback_io = yylval.boolean;
+        get_token(EOS);
+    } else if (strcmp(field, "parallel_io") == 0) {
+        field_repeat_test(repeat_bitset, 22);
+        get_token(BOOLEAN);
+        bfconf->parallel_io = yylval.boolean;
+        get_token(EOS);
     } else {
         parse_error("unrecognised setting name.\n");
     }
@@ -1941,7 +2253,7 @@ load_coeff(struct coeff *coeff,
     void *coeffs, *zbuf = NULL;
     FILE *stream = NULL;
     void **cbuf, *buf;
-    int n, i, j, len;
+    int n, i, j, len, blocklen;
     uint8_t *dest;
 
     if (coeff->shm_elements <= 0 &&
@@ -2086,6 +2398,91 @@ load_coeff(struct coeff *coeff,
             dest += 2 * bfconf->filter_length * realsize;
         }
     }
+    if (!coeff->coeff.is_shared) {
+        /* find out if the coefficient set is a scaled and delayed dirac
+           pulse, which then can be run as a gain and delay only */
+        for (n = 0, j = -1; n < len; n++) {
+            if ((realsize == 4 && ((float *)coeffs)[n] != 0.0) ||
+                (realsize == 8 && ((double *)coeffs)[n] != 0.0))
+            {
+                if (j != -1) {
+                    break;
+                }
+                j = n;
+            }
+        }
+        if (n == len) {
+            bfconf->coeffs_dirac_pos[cindex] = j == -1 ? 0 : j;
+            if (j == -1) {
+                bfconf->coeffs_dirac_gain[cindex] = 0.0;
+            } else if (realsize == 4) {
+                bfconf->coeffs_dirac_gain[cindex] = ((float *)coeffs)[j] * coeff->scale;
+            } else {
+                bfconf->coeffs_dirac_gain[cindex] = ((double *)coeffs)[j] * coeff->scale;
+            }
+        }
+    }
+    if (fuse_td != NULL && fuse_td_len[cindex] == -1 && !coeff->coeff.is_shared) {
+        /* needed for fusion of filter chains, trailing zeroes removed */
+        for (n = len; n > 0; n--) {
+            if ((realsize == 4 && ((float *)coeffs)[n-1] != 0.0) ||
+                (realsize == 8 && ((double *)coeffs)[n-1] != 0.0))
+            {
+                break;
+            }
+        }
+        fuse_td[cindex] = emalloc((n > 0 ? n : 1) * realsize);
+        for (i = 0; i < n; i++) {
+            if (realsize == 4) {
+                ((float *)fuse_td[cindex])[i] =
+                    (float)(((float *)coeffs)[i] * coeff->scale);
+            } else {
+                ((double *)fuse_td[cindex])[i] =
+                    ((double *)coeffs)[i] * coeff->scale;
+            }
+        }
+        fuse_td_len[cindex] = n;
+    }
+    if (bfconf->direct_fir_taps > 0 && !coeff->coeff.is_shared) {
+        /* keep a time-domain copy of short coefficient sets, so filters
+           using them can be run with direct form FIR filtering instead */
+        for (n = len; n > 0; n--) {
+            if ((realsize == 4 && ((float *)coeffs)[n-1] != 0.0) ||
+                (realsize == 8 && ((double *)coeffs)[n-1] != 0.0))
+            {
+                break;
+            }
+        }
+        if (n <= bfconf->direct_fir_taps) {
+            bfconf->coeffs_td[cindex] = emallocaligned((n + 1) * realsize);
+            for (i = 0; i < n; i++) {
+                if (realsize == 4) {
+                    ((float *)bfconf->coeffs_td[cindex])[i] =
+                        (float)(((float *)coeffs)[i] * coeff->scale);
+                } else {
+                    ((double *)bfconf->coeffs_td[cindex])[i] =
+                        ((double *)coeffs)[i] * coeff->scale;
+                }
+            }
+            bfconf->coeffs_td_len[cindex] = n;
+        }
+    }
+    if (bfconf->n_partsizes > 0 && !coeff->coeff.is_shared) {
+        /* frequency-domain partitions for filters with longer partitions */
+        for (i = 0; i < bfconf->n_partsizes; i++) {
+            blocklen = bfconf->partsizes[i];
+            j = i * bfconf->n_coeffs + cindex;
+            bfconf->coeffs_part_n[j] = len > 0 ? (len + blocklen - 1) / blocklen : 1;
+            bfconf->coeffs_part[j] = emalloc(bfconf->coeffs_part_n[j] * sizeof(void *));
+            for (n = 0; n < bfconf->coeffs_part_n[j]; n++) {
+                bfconf->coeffs_part[j][n] = convolver_part_coeffs2cbuf
+                    (&((uint8_t *)coeffs)[n * blocklen * realsize],
+                     len - n * blocklen,
+                     coeff->scale,
+                     blocklen);
+            }
+        }
+    }
     efree(zbuf);
     efree(coeffs);
 #if 0
@@ -2406,6 +2803,7 @@ bfconf_init(char filename[],
     uint32_t repeat_bitset = 0;
     int channels[2][BF_MAXCHANNELS];
     int n, i, j, k, io, token, virtch, physch, maxdelay[2];
+    void **cbuf;
     bool load_balance = false;
     uint64_t t1, t2;
     char str[200];
@@ -2430,6 +2828,9 @@ bfconf_init(char filename[],
     bfconf->quiet = quiet;
     bfconf->realsize = sizeof(float);
     bfconf->safety_limit = 0;
+    bfconf->flush_denormals = true;
+    bfconf->sync_callback_io = false;
+    bfconf->parallel_io = false;
 
     if (!nodefault) {
         get_defaults();
@@ -2746,9 +3147,16 @@ bfconf_init(char filename[],
         }
 
         /* finish delayblocks number */
-        if (pfilters[n]->fctrl.delayblocks > bfconf->n_blocks - 1) {
-            fprintf(stderr, "Delay in filter %d/\"%s\" is too large (max allowed is %d blocks, max blocks - 1).\n",
-                    n, pfilters[n]->filter.name, bfconf->n_blocks - 1);
+        if (pfilters[n]->filter.maxdelay > 0 && bfconf->n_blocks == 1) {
+            fprintf(stderr, "Filter %d/\"%s\" cannot have maxdelay with a single block.\n",
+                    n, pfilters[n]->filter.name);
+            exit(BF_EXIT_INVALID_CONFIG);
+        }
+        if (pfilters[n]->fctrl.delayblocks > bfconf->n_blocks - 1 + pfilters[n]->filter.maxdelay) {
+            fprintf(stderr, "Delay in filter %d/\"%s\" is too large (max allowed is %d blocks, "
+                    "max blocks - 1 + maxdelay).\n",
+                    n, pfilters[n]->filter.name,
+                    bfconf->n_blocks - 1 + pfilters[n]->filter.maxdelay);
             exit(BF_EXIT_INVALID_CONFIG);
         }
     }
@@ -2817,6 +3225,51 @@ bfconf_init(char filename[],
         }
     }
 
+    /* check filters with a longer partition than the filter length, and
+       collect the different partition lengths */
+    bfconf->partsizes = emalloc(32 * sizeof(int));
+    for (n = 0; n < bfconf->n_filters; n++) {
+        if (bfconf->filters[n].partition == 0) {
+            continue;
+        }
+        if (bfconf->filters[n].partition <= bfconf->filter_length) {
+            fprintf(stderr, "Partition of filter %d/\"%s\" must be longer than "
+                    "the filter length.\n", n, bfconf->filters[n].name);
+            exit(BF_EXIT_INVALID_CONFIG);
+        }
+        if (log2_get(bfconf->filters[n].partition) == -1) {
+            fprintf(stderr, "Partition of filter %d/\"%s\" is not a power of two.\n",
+                    n, bfconf->filters[n].name);
+            exit(BF_EXIT_INVALID_CONFIG);
+        }
+        if (bfconf->filters[n].n_filters[IN] > 0 ||
+            bfconf->filters[n].n_filters[OUT] > 0 ||
+            bfconf->filters[n].crossfade ||
+            bfconf->filters[n].maxdelay > 0 ||
+            bfconf->initfctrl[n].delayblocks > 0)
+        {
+            fprintf(stderr, "Filter %d/\"%s\" with partition cannot have "
+                    "filter inputs or outputs, crossfade, delay or "
+                    "maxdelay.\n",
+                    n, bfconf->filters[n].name);
+            exit(BF_EXIT_INVALID_CONFIG);
+        }
+        for (i = 0; i < bfconf->n_partsizes; i++) {
+            if (bfconf->partsizes[i] == bfconf->filters[n].partition) {
+                break;
+            }
+        }
+        if (i == bfconf->n_partsizes) {
+            bfconf->partsizes[bfconf->n_partsizes++] = bfconf->filters[n].partition;
+        }
+    }
+    if (bfconf->n_partsizes > 0) {
+        bfconf->coeffs_part = emalloc(bfconf->n_partsizes * bfconf->n_coeffs * sizeof(void **));
+        memset(bfconf->coeffs_part, 0, bfconf->n_partsizes * bfconf->n_coeffs * sizeof(void **));
+        bfconf->coeffs_part_n = emalloc(bfconf->n_partsizes * bfconf->n_coeffs * sizeof(int));
+        memset(bfconf->coeffs_part_n, 0, bfconf->n_partsizes * bfconf->n_coeffs * sizeof(int));
+    }
+
     /* check so there are no filter loops */
     for (n = 0; n < bfconf->n_filters; n++) {
         if (filter_loop(n, n)) {
@@ -2861,8 +3314,49 @@ bfconf_init(char filename[],
         }
     }
 
+    if (bfconf->direct_fir_taps > bfconf->filter_length) {
+        fprintf(stderr, "The direct_fir_taps cannot be larger than filter_length.\n");
+        exit(BF_EXIT_INVALID_CONFIG);
+    }
+    if (bfconf->direct_fir_taps > 0 && bfconf->filter_length < 4) {
+        fprintf(stderr, "The direct_fir_taps requires a filter_length of at least 4.\n");
+        exit(BF_EXIT_INVALID_CONFIG);
+    }
+
+    /* find filter chains which may be fused into one filter, and mark
+       which coefficient sets we need the time-domain data of */
+    bfconf->fuse_src = emalloc(bfconf->n_filters * sizeof(int));
+    bfconf->fuse_src_coeff = emalloc(bfconf->n_filters * sizeof(int));
+    bfconf->fuse_own_coeff = emalloc(bfconf->n_filters * sizeof(int));
+    bfconf->fuse_coeff = emalloc(bfconf->n_filters * sizeof(int));
+    for (n = 0; n < bfconf->n_filters; n++) {
+        bfconf->fuse_src[n] = -1;
+        if (!fuse_candidate(n)) {
+            continue;
+        }
+        fuse_mark(bfconf->initfctrl[bfconf->filters[n].filters[IN][0]].coeff);
+        fuse_mark(bfconf->initfctrl[n].coeff);
+    }
+    for (n = 0; n < bfconf->n_filters; n++) {
+        if ((bfconf->use_subdelay[IN] || bfconf->use_subdelay[OUT]) &&
+            sdfold_candidate(n))
+        {
+            fuse_mark(bfconf->initfctrl[n].coeff);
+        }
+    }
+
     /* load coefficients */
     bfconf->coeffs_data = emalloc(bfconf->n_coeffs * sizeof(void **));
+    bfconf->coeffs_td = emalloc(bfconf->n_coeffs * sizeof(void *));
+    memset(bfconf->coeffs_td, 0, bfconf->n_coeffs * sizeof(void *));
+    bfconf->coeffs_td_len = emalloc(bfconf->n_coeffs * sizeof(int));
+    memset(bfconf->coeffs_td_len, 0, bfconf->n_coeffs * sizeof(int));
+    bfconf->coeffs_dirac_pos = emalloc(bfconf->n_coeffs * sizeof(int));
+    bfconf->coeffs_dirac_gain = emalloc(bfconf->n_coeffs * sizeof(double));
+    for (n = 0; n < bfconf->n_coeffs; n++) {
+        bfconf->coeffs_dirac_pos[n] = -1;
+        bfconf->coeffs_dirac_gain[n] = 0.0;
+    }
     bfconf->coeffs = emalloc(bfconf->n_coeffs * sizeof(struct bfcoeff));
     if (bfconf->n_coeffs == 1) {
         pinfo("Loading coefficient set...");
@@ -2885,6 +3379,77 @@ bfconf_init(char filename[],
     }
     efree(coeffs);
 
+    /* fuse filter chains with static coefficients into one filter, by
+       convolving the coefficient sets. The fused sets are put after the
+       ordinary ones so they cannot be selected by the user. */
+    for (n = 0; n < bfconf->n_filters; n++) {
+        if (!fuse_candidate(n)) {
+            continue;
+        }
+        i = bfconf->initfctrl[bfconf->filters[n].filters[IN][0]].coeff;
+        j = bfconf->initfctrl[n].coeff;
+        if ((i >= 0 && fuse_td[i] == NULL) || (j >= 0 && fuse_td[j] == NULL)) {
+            /* shared or processed coefficient sets */
+            continue;
+        }
+        if (i < 0 || j < 0) {
+            /* one is a dirac pulse, so the other is the result */
+            k = i < 0 ? j : i;
+        } else {
+            cbuf = fuse_coeffs(fuse_td[i], fuse_td_len[i],
+                               fuse_td[j], fuse_td_len[j], &k);
+            if (cbuf == NULL) {
+                continue;
+            }
+            k = add_hidden_coeff(cbuf, k);
+        }
+        bfconf->fuse_src[n] = bfconf->filters[n].filters[IN][0];
+        bfconf->fuse_src_coeff[n] = i;
+        bfconf->fuse_own_coeff[n] = j;
+        bfconf->fuse_coeff[n] = k;
+    }
+    sdfold_init();
+    if (fuse_td != NULL) {
+        for (n = 0; n < bfconf->n_coeffs; n++) {
+            efree(fuse_td[n]);
+        }
+        efree(fuse_td);
+        efree(fuse_td_len);
+        fuse_td = NULL;
+    }
+    for (n = 0; n < bfconf->n_filters; n++) {
+        k = bfconf->initfctrl[n].coeff;
+        if (bfconf->filters[n].partition == 0 || k < 0) {
+            continue;
+        }
+        for (i = 0; bfconf->partsizes[i] != bfconf->filters[n].partition; i++);
+        if (bfconf->coeffs_part[i * bfconf->n_coeffs + k] == NULL) {
+            fprintf(stderr, "Filter %d/\"%s\" with partition cannot use a "
+                    "shared or processed coefficient set.\n",
+                    n, bfconf->filters[n].name);
+            exit(BF_EXIT_INVALID_CONFIG);
+        }
+    }
+
+    /* find filters which are computationally identical to an earlier
+       filter in the same process */
+    bfconf->cse_master = emalloc(bfconf->n_filters * sizeof(int));
+    for (n = 0; n < bfconf->n_filters; n++) {
+        bfconf->cse_master[n] = -1;
+        if (!cse_candidate(&bfconf->filters[n])) {
+            continue;
+        }
+        for (i = 0; i < n; i++) {
+            if (bfconf->cse_master[i] == -1 &&
+                cse_candidate(&bfconf->filters[i]) &&
+                cse_equal(pfilters[i], pfilters[n]))
+            {
+                bfconf->cse_master[n] = i;
+                break;
+            }
+        }
+    }
+
     /* shorten mute array */
     FOR_IN_AND_OUT {
         bfconf->mute[IO] = erealloc(bfconf->mute[IO], bfconf->n_channels[IO] * sizeof(bool));
@@ -3075,6 +3640,10 @@ bfconf_init(char filename[],
             }
         }
     }
+    if (bfconf->sync_callback_io && (!bfconf->callback_io || bfconf->blocking_io)) {
+        fprintf(stderr, "sync_callback_io requires that all I/O is callback I/O.\n");
+        exit(BF_EXIT_INVALID_CONFIG);
+    }
     bfconf->iomods = erealloc(bfconf->iomods, bfconf->n_iomods *
                               sizeof(struct bfio_module));
     bfconf->ionames = erealloc(bfconf->ionames, bfconf->n_iomods *
@@ -3230,12 +3799,7 @@ bfconf_init(char filename[],
     memset(bfconf->dither_state, 0, bfconf->n_physical_channels[OUT] *
            sizeof(struct dither_state *));
     if (j > 0) {
-        if (!dither_init(j, bfconf->sampling_rate, bfconf->realsize,
-                         bfconf->max_dither_table_size, bfconf->filter_length,
-                         dither_state))
-        {
-            exit(BF_EXIT_OTHER);
-        }
+        dither_init(j, bfconf->realsize, bfconf->filter_length, dither_state);
         for (n = j = 0; n < bfconf->n_physical_channels[OUT]; n++) {
             if (bit32_isset(apply_dither, n)) {
                 bfconf->dither_state[n] = dither_state[j];
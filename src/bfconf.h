@@ -22,7 +22,6 @@ struct bfconf {
     int sampling_rate;
     int filter_length;
     int n_blocks;
-    int max_dither_table_size;
     int flowthrough_blocks;
     int realtime_maxprio;
     int realtime_midprio;
@@ -47,6 +46,23 @@ struct bfconf {
     int n_coeffs;
     struct bfcoeff *coeffs;
     void ***coeffs_data;
+    void **coeffs_td;
+    int *coeffs_td_len;
+    int *coeffs_dirac_pos;
+    double *coeffs_dirac_gain;
+    int *fuse_src;
+    int *fuse_src_coeff;
+    int *fuse_own_coeff;
+    int *fuse_coeff;
+    int n_fused_coeffs;
+    int *cse_master;
+    bool use_sdfold;
+    bool *sdfold[2];
+    int *sdfold_coeff;
+    int n_partsizes;
+    int *partsizes;
+    void ***coeffs_part;
+    int *coeffs_part_n;
     int n_channels[2];
     struct bfchannel *channels[2];
     int n_physical_channels[2];
@@ -74,6 +90,10 @@ struct bfconf {
     int sdf_length;
     double sdf_beta;
     double safety_limit;
+    int direct_fir_taps;
+    bool flush_denormals;
+    bool sync_callback_io;
+    bool parallel_io;
 };
 
 extern struct bfconf *bfconf;
@@ -1,5 +1,5 @@
 /*
- * (c) Copyright 2001 - 2004, 2006 -- Anders Torger
+ * (c) Copyright 2001 - 2004, 2006, 2026 -- Anders Torger
  *
  * This program is open source. For license terms, see the LICENSE file.
  *
@@ -13,7 +13,16 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/uio.h>
+#include <sys/mman.h>
 #include <fcntl.h>
+#include <signal.h>
+#include <float.h>
+#include <poll.h>
+#include <sched.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #ifndef O_LARGEFILE
 #define O_LARGEFILE 0
@@ -23,8 +32,74 @@
 #include "bfmod.h"
 #include "bit.h"
 
-#define TEXT_BUFFER_SIZE 4096
-#define OUTTEXT_FORMAT "%+.16e"
+#define TEXT_BUFFER_SIZE 65536
+#define TEXT_PADDING 16 /* for reading text in 16 byte chunks */
+#define TEXT_MAXLEN 32 /* max length of a formatted sample and separator */
+#define DEFAULT_BUFFER_PERIODS 16
+
+/*
+  Text samples are converted with extended precision, where a decimal
+  number of up to 19 digits and a power of ten of up to 27 are exact and
+  the product or quotient is rounded once. The result is then only wrong
+  when rounded again to double if it lies exactly halfway between two
+  doubles, and then the C library is used instead.
+*/
+#if LDBL_MANT_DIG >= 64
+#define TEXT_FAST_CONVERSION 1
+static const long double text_pow10[28] = {
+    1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L,
+    1e7L, 1e8L, 1e9L, 1e10L, 1e11L, 1e12L, 1e13L,
+    1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L, 1e20L,
+    1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L
+};
+#else
+#define TEXT_FAST_CONVERSION 0
+#endif
+
+/*
+  Raw samples in regular files are read through memory mapped windows of
+  the file, which a helper thread maps and prefaults ahead of the reader,
+  and written through a ring buffer which a helper thread writes to the
+  file behind the writer. This way the input and output processes only
+  copy memory, and wait for the disk only if it cannot keep up with the
+  sample rate over the buffered periods.
+*/
+struct mapwindow {
+    uint8_t *map;
+    size_t map_size;
+    off_t map_offset;
+    off_t begin;
+    off_t end;
+};
+
+struct readahead {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool started;
+    bool stop;
+    bool eof;
+    int error;
+    int n_windows;
+    int head;
+    int count;
+    off_t nextpos;
+    size_t window_size;
+    struct mapwindow *windows;
+};
+
+struct writebehind {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool started;
+    bool stop;
+    int error;
+    size_t size;
+    size_t head;
+    size_t fill;
+    uint8_t *buf;
+};
 
 struct readstate {
     off_t filesize;
@@ -32,6 +107,9 @@ struct readstate {
     off_t curpos;
     bool loop;
     bool use_text;
+    bool use_map;
+    int fd;
+    struct readahead ra;
     struct {
         int dupfd;
         int filefd;
@@ -45,13 +123,14 @@ struct readstate {
 struct writestate {
     int open_channels;
     bool use_text;
+    bool use_ring;
+    int fd;
+    struct writebehind wb;
     struct {
         int bufsize;
         int offset;
         int print_offset;
-        int partial_offset;
         char *buffer;
-        char *partial_buffer;
     } text;
 };
 
@@ -60,11 +139,11 @@ static struct writestate *writestate[FD_SETSIZE];
 static fd_set fds[2];
 static int fdmax[2] = { -1, -1 };
 static bool debug = false;
-static int outtext_len;
 static int read_ready_fd = -1;
 
 struct settings {
     off_t skipbytes;
+    int buffer_periods;
     bool append;
     bool loop;
     bool text;
@@ -103,6 +182,7 @@ bfio_preinit(int *version_major,
     debug = !!_debug;
     settings = malloc(sizeof(struct settings));
     memset(settings, 0, sizeof(struct settings));
+    settings->buffer_periods = DEFAULT_BUFFER_PERIODS;
     while ((token = get_config_token(&lexval)) > 0) {
         if (token == BF_LEXVAL_FIELD) {
             if (strcmp(lexval.field, "path") == 0) {
@@ -116,6 +196,14 @@ bfio_preinit(int *version_major,
             } else if (strcmp(lexval.field, "skip") == 0) {
                 GET_TOKEN(BF_LEXVAL_REAL, "expected integer.\n");
                 settings->skipbytes = (off_t)lexval.real;
+            } else if (strcmp(lexval.field, "buffer") == 0) {
+                GET_TOKEN(BF_LEXVAL_REAL, "expected integer.\n");
+                settings->buffer_periods = (int)lexval.real;
+                if (settings->buffer_periods < 0) {
+                    fprintf(stderr, "File I/O: Parse error: buffer must not "
+                            "be negative.\n");
+                    return NULL;
+                }
             } else if (strcmp(lexval.field, "append") == 0) {
                 if (io == BF_IN) {
                     fprintf(stderr, "File I/O: Append on input makes "
@@ -192,6 +280,332 @@ bfio_preinit(int *version_major,
     return settings;
 }
 
+static bool
+sync_init(pthread_mutex_t *mutex,
+          pthread_cond_t *cond)
+{
+    pthread_mutexattr_t attr;
+
+    /* the helper threads run with normal priority (see start_thread()),
+       so they must not hold up the realtime reader or writer while
+       holding the lock */
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    if (pthread_mutex_init(mutex, &attr) != 0 ||
+        pthread_cond_init(cond, NULL) != 0)
+    {
+        fprintf(stderr, "File I/O: Could not init thread lock.\n");
+        pthread_mutexattr_destroy(&attr);
+        return false;
+    }
+    pthread_mutexattr_destroy(&attr);
+    return true;
+}
+
+static bool
+start_thread(pthread_t *thread,
+             void *(*thread_func)(void *arg),
+             void *arg)
+{
+    struct sched_param param;
+    pthread_attr_t attr;
+    sigset_t signals;
+    int error;
+
+    /*
+     * The caller is the realtime input or output process, whose scheduling
+     * would otherwise be inherited. The helper threads wait for the disk,
+     * and must not compete with the realtime threads for the CPU.
+     */
+    memset(&param, 0, sizeof(param));
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+    pthread_attr_setschedparam(&attr, &param);
+
+    /* no signals to child thread */
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    error = pthread_create(thread, &attr, thread_func, arg);
+    pthread_sigmask(SIG_UNBLOCK, &signals, NULL);
+    pthread_attr_destroy(&attr);
+    if (error != 0) {
+        fprintf(stderr, "File I/O: Could not start thread: %s.\n",
+                strerror(error));
+        return false;
+    }
+    return true;
+}
+
+/*
+ * SIGINT and SIGTERM exit through bfio_stop(), which takes the helper thread
+ * locks and joins the thread. They are therefore held back while the
+ * process itself holds or waits for those locks, and delivered when it is
+ * done (which may be after waiting for the disk).
+ */
+static void
+block_stop_signals(sigset_t *oldset)
+{
+    sigset_t signals;
+
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, oldset);
+}
+
+static bool
+readahead_init(struct readahead *ra,
+               struct readstate *rs,
+               int periods,
+               int period_bytes)
+{
+    long pagesize = sysconf(_SC_PAGESIZE);
+
+    if (!sync_init(&ra->mutex, &ra->cond)) {
+        return false;
+    }
+    ra->window_size = (period_bytes + pagesize - 1) / pagesize * pagesize;
+    ra->n_windows = periods < 2 ? 2 : periods;
+    ra->windows = malloc(ra->n_windows * sizeof(struct mapwindow));
+    memset(ra->windows, 0, ra->n_windows * sizeof(struct mapwindow));
+    ra->nextpos = rs->skipbytes;
+    ra->eof = ra->nextpos >= rs->filesize;
+    return true;
+}
+
+static void *
+readahead_thread(void *arg)
+{
+    struct readstate *rs = (struct readstate *)arg;
+    struct readahead *ra = &rs->ra;
+    long pagesize = sysconf(_SC_PAGESIZE);
+    volatile uint8_t sum = 0;
+
+    pthread_mutex_lock(&ra->mutex);
+    while (!ra->stop) {
+        if (ra->eof || ra->count == ra->n_windows) {
+            pthread_cond_wait(&ra->cond, &ra->mutex);
+            continue;
+        }
+        /* slots outside head to head + count are already read */
+        struct mapwindow *w =
+            &ra->windows[(ra->head + ra->count) % ra->n_windows];
+        pthread_mutex_unlock(&ra->mutex);
+
+        if (w->map != NULL) {
+            munmap(w->map, w->map_size);
+            w->map = NULL;
+        }
+        w->begin = ra->nextpos;
+        w->map_offset = w->begin - w->begin % pagesize;
+        w->end = w->map_offset + (off_t)ra->window_size;
+        if (w->end > rs->filesize) {
+            w->end = rs->filesize;
+        }
+        w->map_size = (size_t)(w->end - w->map_offset);
+        void *map = mmap(NULL, w->map_size, PROT_READ, MAP_SHARED, rs->fd,
+                         w->map_offset);
+        if (map == MAP_FAILED) {
+            fprintf(stderr, "File I/O: Could not map file: %s.\n",
+                    strerror(errno));
+            pthread_mutex_lock(&ra->mutex);
+            ra->error = errno;
+            ra->eof = true;
+            pthread_cond_broadcast(&ra->cond);
+            continue;
+        }
+        w->map = (uint8_t *)map;
+        /* fault in the pages here so the reader will not wait for disk */
+        posix_madvise(map, w->map_size, POSIX_MADV_WILLNEED);
+        for (size_t n = 0; n < w->map_size; n += pagesize) {
+            sum += w->map[n];
+        }
+
+        pthread_mutex_lock(&ra->mutex);
+        ra->count++;
+        ra->nextpos = w->end;
+        if (ra->nextpos == rs->filesize) {
+            if (rs->loop) {
+                ra->nextpos = rs->skipbytes;
+            } else {
+                ra->eof = true;
+            }
+        }
+        pthread_cond_broadcast(&ra->cond);
+    }
+    pthread_mutex_unlock(&ra->mutex);
+    return NULL;
+}
+
+static int
+map_read(struct readstate *rs,
+         uint8_t *buf,
+         int count)
+{
+    struct readahead *ra = &rs->ra;
+    int n = 0;
+
+    if (!ra->started) {
+        if (!start_thread(&ra->thread, readahead_thread, rs)) {
+            errno = EIO;
+            return -1;
+        }
+        ra->started = true;
+    }
+    pthread_mutex_lock(&ra->mutex);
+    while (n < count) {
+        while (ra->count == 0 && !ra->eof) {
+            /* the disk is behind */
+            pthread_cond_wait(&ra->cond, &ra->mutex);
+        }
+        if (ra->count == 0) {
+            break;
+        }
+        struct mapwindow *w = &ra->windows[ra->head];
+        pthread_mutex_unlock(&ra->mutex);
+
+        int size = count - n;
+        if ((off_t)size > w->end - w->begin) {
+            size = (int)(w->end - w->begin);
+        }
+        memcpy(&buf[n], &w->map[w->begin - w->map_offset], size);
+        w->begin += size;
+        n += size;
+
+        pthread_mutex_lock(&ra->mutex);
+        if (w->begin == w->end) {
+            ra->head = (ra->head + 1) % ra->n_windows;
+            ra->count--;
+            pthread_cond_broadcast(&ra->cond);
+        }
+    }
+    if (n == 0 && ra->error != 0) {
+        pthread_mutex_unlock(&ra->mutex);
+        errno = EIO;
+        return -1;
+    }
+    pthread_mutex_unlock(&ra->mutex);
+    return n;
+}
+
+static bool
+writebehind_init(struct writebehind *wb,
+                 int periods,
+                 int period_bytes)
+{
+    if (!sync_init(&wb->mutex, &wb->cond)) {
+        return false;
+    }
+    wb->size = (size_t)(periods < 2 ? 2 : periods) * period_bytes;
+    wb->buf = malloc(wb->size);
+    return true;
+}
+
+static void *
+writebehind_thread(void *arg)
+{
+    struct writestate *ws = (struct writestate *)arg;
+    struct writebehind *wb = &ws->wb;
+
+    pthread_mutex_lock(&wb->mutex);
+    while (true) {
+        if (wb->fill == 0) {
+            if (wb->stop) {
+                break;
+            }
+            pthread_cond_wait(&wb->cond, &wb->mutex);
+            continue;
+        }
+        /* the writer only adds after head + fill, so this part is ours */
+        size_t size = wb->fill;
+        if (size > wb->size - wb->head) {
+            size = wb->size - wb->head;
+        }
+        const uint8_t *p = &wb->buf[wb->head];
+        pthread_mutex_unlock(&wb->mutex);
+
+        size_t written = 0;
+        int error = 0;
+        while (written < size) {
+            ssize_t retval = write(ws->fd, &p[written], size - written);
+            if (retval == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN) {
+                    /* the descriptor is non-blocking, wait instead of
+                       spinning */
+                    struct pollfd pfd = { .fd = ws->fd, .events = POLLOUT };
+                    poll(&pfd, 1, -1);
+                    continue;
+                }
+                error = errno;
+                fprintf(stderr, "File I/O: Write failed: %s.\n",
+                        strerror(errno));
+                break;
+            }
+            written += retval;
+        }
+
+        pthread_mutex_lock(&wb->mutex);
+        if (error != 0) {
+            wb->error = error;
+            pthread_cond_broadcast(&wb->cond);
+            break;
+        }
+        wb->head = (wb->head + size) % wb->size;
+        wb->fill -= size;
+        pthread_cond_broadcast(&wb->cond);
+    }
+    pthread_mutex_unlock(&wb->mutex);
+    return NULL;
+}
+
+static int
+ring_write(struct writestate *ws,
+           const uint8_t *buf,
+           int count)
+{
+    struct writebehind *wb = &ws->wb;
+
+    if (!wb->started) {
+        if (!start_thread(&wb->thread, writebehind_thread, ws)) {
+            errno = EIO;
+            return -1;
+        }
+        wb->started = true;
+    }
+    if ((size_t)count > wb->size) {
+        count = (int)wb->size;
+    }
+    pthread_mutex_lock(&wb->mutex);
+    while (wb->size - wb->fill < (size_t)count && wb->error == 0) {
+        /* the disk is behind */
+        pthread_cond_wait(&wb->cond, &wb->mutex);
+    }
+    if (wb->error != 0) {
+        pthread_mutex_unlock(&wb->mutex);
+        errno = EIO;
+        return -1;
+    }
+    const size_t tail = (wb->head + wb->fill) % wb->size;
+    pthread_mutex_unlock(&wb->mutex);
+
+    size_t size = (size_t)count;
+    if (size > wb->size - tail) {
+        size = wb->size - tail;
+    }
+    memcpy(&wb->buf[tail], buf, size);
+    memcpy(wb->buf, &buf[size], count - size);
+
+    pthread_mutex_lock(&wb->mutex);
+    wb->fill += count;
+    pthread_cond_signal(&wb->cond);
+    pthread_mutex_unlock(&wb->mutex);
+    return count;
+}
+
 int
 bfio_init(void *params,
           int io,
@@ -215,10 +629,6 @@ bfio_init(void *params,
     struct readstate *rs;
     struct stat buf;
     int fd, mode;
-    char s_[128];
-
-    snprintf(s_, sizeof(s_), OUTTEXT_FORMAT, 1.0);
-    outtext_len = strlen(s_);
 
     settings = (struct settings *)params;
     *device_period_size = 0;
@@ -251,7 +661,25 @@ bfio_init(void *params,
         rs->skipbytes = settings->skipbytes;
         rs->loop = settings->loop;
         rs->use_text = settings->text;
-        if (settings->skipbytes > 0) {
+        rs->fd = fd;
+        if (!settings->text && settings->buffer_periods > 0) {
+            if (fstat(fd, &buf) != 0) {
+                fprintf(stderr, "File I/O: Could not stat file \"%s\": %s.\n",
+                        settings->path, strerror(errno));
+                return -1;
+            }
+            if (S_ISREG(buf.st_mode)) {
+                rs->use_map = true;
+                rs->filesize = buf.st_size;
+                if (!readahead_init(&rs->ra, rs, settings->buffer_periods,
+                                    period_size * open_channels *
+                                    bf_sampleformat_size(sample_format)))
+                {
+                    return -1;
+                }
+            }
+        }
+        if (settings->skipbytes > 0 && !rs->use_map) {
             if (lseek(fd, settings->skipbytes, SEEK_SET) == -1) {
                 fprintf(stderr, "File seek failed.\n");
                 return -1;
@@ -260,7 +688,7 @@ bfio_init(void *params,
         }
         if (settings->text) {
             rs->text.filefd = fd;
-            rs->text.buffer = malloc(TEXT_BUFFER_SIZE + 1);
+            rs->text.buffer = malloc(TEXT_BUFFER_SIZE + TEXT_PADDING);
             rs->text.buffer[0] = '\0';
             rs->text.bufsize = TEXT_BUFFER_SIZE;
             if ((fd = dup(read_ready_fd)) == -1) {
@@ -289,10 +717,26 @@ bfio_init(void *params,
         memset(ws, 0, sizeof(struct writestate));
         ws->open_channels = open_channels;
         ws->use_text = settings->text;
+        ws->fd = fd;
+        if (!settings->text && settings->buffer_periods > 0) {
+            if (fstat(fd, &buf) != 0) {
+                fprintf(stderr, "File I/O: Could not stat file \"%s\": %s.\n",
+                        settings->path, strerror(errno));
+                return -1;
+            }
+            if (S_ISREG(buf.st_mode)) {
+                ws->use_ring = true;
+                if (!writebehind_init(&ws->wb, settings->buffer_periods,
+                                      period_size * open_channels *
+                                      bf_sampleformat_size(sample_format)))
+                {
+                    return -1;
+                }
+            }
+        }
         if (settings->text) {
-            ws->text.partial_buffer = malloc(open_channels * (outtext_len + 1));
             ws->text.bufsize = TEXT_BUFFER_SIZE;
-            while (ws->text.bufsize < open_channels * (outtext_len + 1)) {
+            while (ws->text.bufsize < 2 * open_channels * TEXT_MAXLEN) {
                 ws->text.bufsize += TEXT_BUFFER_SIZE;
             }
             ws->text.buffer = malloc(ws->text.bufsize);
@@ -308,6 +752,275 @@ bfio_init(void *params,
     return fd;
 }
 
+/* find the end of a text entry, the buffer is terminated with '\0' */
+static char *
+text_delimiter(char *p)
+{
+#ifdef __SSE2__
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i sp = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i nul = _mm_setzero_si128();
+    while (true) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)p);
+        const __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, nl),
+                                                    _mm_cmpeq_epi8(v, sp)),
+                                       _mm_or_si128(_mm_cmpeq_epi8(v, tab),
+                                                    _mm_cmpeq_epi8(v, nul)));
+        const int mask = _mm_movemask_epi8(m);
+        if (mask != 0) {
+            return p + bit32_bsf((uint32_t)mask);
+        }
+        p += 16;
+    }
+#else
+    while (*p != '\n' && *p != ' ' && *p != '\t' && *p != '\0') {
+        p++;
+    }
+    return p;
+#endif
+}
+
+#if TEXT_FAST_CONVERSION
+/* m * 10^e in extended precision, or -1 if it does not round to a
+   double without the risk of double rounding */
+static double
+text_scale(uint64_t m,
+           int e)
+{
+    uint64_t bits;
+    double d, nd;
+
+    if (e < -27 || e > 27) {
+        return -1.0;
+    }
+    const long double y = e < 0 ? (long double)m / text_pow10[-e] :
+        (long double)m * text_pow10[e];
+    d = (double)y;
+    if ((long double)d == y) {
+        return d;
+    }
+    /* the neighbour on the other side of y, check if y is halfway */
+    memcpy(&bits, &d, sizeof(bits));
+    bits = (long double)d < y ? bits + 1 : bits - 1;
+    memcpy(&nd, &bits, sizeof(nd));
+    if ((long double)d + (long double)nd == 2.0L * y) {
+        return -1.0;
+    }
+    return d;
+}
+#endif
+
+/* same as strtod(), but faster for plain decimal numbers */
+static double
+text_parse(const char *s,
+           char **endptr)
+{
+#if TEXT_FAST_CONVERSION
+    const char *p = s;
+    uint64_t m = 0;
+    int digits = 0, e = 0;
+    bool neg = false, any = false;
+
+    if (*p == '-' || *p == '+') {
+        neg = *p == '-';
+        p++;
+    }
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        goto slow;
+    }
+    for (; *p >= '0' && *p <= '9'; p++) {
+        any = true;
+        if (m == 0 && *p == '0') {
+            continue;
+        }
+        if (digits == 19) {
+            goto slow;
+        }
+        m = m * 10 + (uint64_t)(*p - '0');
+        digits++;
+    }
+    if (*p == '.') {
+        for (p++; *p >= '0' && *p <= '9'; p++) {
+            any = true;
+            e--;
+            if (m == 0 && *p == '0') {
+                continue;
+            }
+            if (digits == 19) {
+                goto slow;
+            }
+            m = m * 10 + (uint64_t)(*p - '0');
+            digits++;
+        }
+    }
+    if (!any) {
+        /* infinity, nan or not a number at all */
+        goto slow;
+    }
+    if (*p == 'e' || *p == 'E') {
+        const char *q = p + 1;
+        bool eneg = false;
+        int ee = 0;
+        if (*q == '-' || *q == '+') {
+            eneg = *q == '-';
+            q++;
+        }
+        if (*q >= '0' && *q <= '9') {
+            for (; *q >= '0' && *q <= '9'; q++) {
+                if (ee < 10000) {
+                    ee = ee * 10 + (*q - '0');
+                }
+            }
+            e += eneg ? -ee : ee;
+            p = q;
+        }
+    }
+    double d = 0.0;
+    if (m != 0 && (d = text_scale(m, e)) < 0.0) {
+        goto slow;
+    }
+    *endptr = (char *)p;
+    return neg ? -d : d;
+ slow:
+#endif
+    return strtod(s, endptr);
+}
+
+/* write a number with the given significant digits and decimal exponent,
+   in fixed notation if it is not too small or large */
+static int
+text_emit(char *s,
+          bool neg,
+          const char digits[],
+          int n_digits,
+          int k)
+{
+    char *p = s;
+
+    while (n_digits > 1 && digits[n_digits - 1] == '0') {
+        n_digits--;
+    }
+    if (neg) {
+        *p++ = '-';
+    }
+    if (k >= -4 && k < 17) {
+        if (k < 0) {
+            *p++ = '0';
+            *p++ = '.';
+            for (int n = -1; n > k; n--) {
+                *p++ = '0';
+            }
+            memcpy(p, digits, n_digits);
+            p += n_digits;
+        } else {
+            for (int n = 0; n <= k; n++) {
+                *p++ = n < n_digits ? digits[n] : '0';
+            }
+            if (n_digits > k + 1) {
+                *p++ = '.';
+                memcpy(p, &digits[k + 1], n_digits - k - 1);
+                p += n_digits - k - 1;
+            }
+        }
+        return p - s;
+    }
+    *p++ = digits[0];
+    if (n_digits > 1) {
+        *p++ = '.';
+        memcpy(p, &digits[1], n_digits - 1);
+        p += n_digits - 1;
+    }
+    *p++ = 'e';
+    *p++ = k < 0 ? '-' : '+';
+    if (k < 0) {
+        k = -k;
+    }
+    if (k >= 100) {
+        *p++ = '0' + k / 100;
+    }
+    *p++ = '0' + k / 10 % 10;
+    *p++ = '0' + k % 10;
+    return p - s;
+}
+
+/* write the shortest number which reads back as the same double */
+static int
+text_format(char *s,
+            double x)
+{
+    char digits[24];
+    uint64_t bits;
+
+    memcpy(&bits, &x, sizeof(bits));
+    const bool neg = (bits >> 63) != 0;
+    if (x == 0.0) {
+        return text_emit(s, neg, "0", 1, 0);
+    }
+    if (x != x || x - x != 0.0) {
+        /* nan or infinity */
+        return sprintf(s, "%g", x);
+    }
+    const double ax = neg ? -x : x;
+#if TEXT_FAST_CONVERSION
+    /* 10^k <= ax < 10^(k + 1) for k being this or one more */
+    const int k0 = ((int)((bits >> 52) & 0x7FF) - 1023) * 78913 >> 18;
+    for (int p = 15; p <= 17; p++) {
+        uint64_t m = 0;
+        int k = k0;
+        for (int i = 0; i < 2; i++, k++) {
+            const int e = p - 1 - k;
+            if (e < -27 || e > 27) {
+                break;
+            }
+            const long double y = e < 0 ? (long double)ax / text_pow10[-e] :
+                (long double)ax * text_pow10[e];
+            m = (uint64_t)(y + 0.5L);
+            if (m < (uint64_t)text_pow10[p]) {
+                break;
+            }
+            m = 0;
+        }
+        if (m == 0) {
+            break;
+        }
+        if (m < (uint64_t)text_pow10[p - 1]) {
+            /* k0 was one too large, which the rounding cannot do */
+            break;
+        }
+        double v = text_scale(m, k - p + 1);
+        for (int n = p - 1; n >= 0; n--) {
+            digits[n] = '0' + (char)(m % 10);
+            m /= 10;
+        }
+        const int len = text_emit(s, neg, digits, p, k);
+        if (v < 0.0) {
+            /* close to halfway, let the C library read it back */
+            s[len] = '\0';
+            v = strtod(s, NULL);
+            if (neg) {
+                v = -v;
+            }
+        }
+        if (v == ax) {
+            return len;
+        }
+    }
+#endif
+    /* let the C library find the digits */
+    char buf[32];
+    for (int p = 1; p <= 17; p++) {
+        snprintf(buf, sizeof(buf), "%.*e", p - 1, ax);
+        if (p == 17 || strtod(buf, NULL) == ax) {
+            const int dot = p > 1 ? 1 : 0;
+            digits[0] = buf[0];
+            memcpy(&digits[1], &buf[1 + dot], p - 1);
+            return text_emit(s, neg, digits, p, atoi(&buf[p + dot + 1]));
+        }
+    }
+    return 0;
+}
+
 static int
 text_read(int fd,
           void *buf,
@@ -325,9 +1038,7 @@ text_read(int fd,
 
     while (i < count) {
         parsebuf = &rs->text.buffer[rs->text.parse_offset];
-        for (p = parsebuf;
-             *p != '\n' && *p != ' ' && *p != '\t' && *p != '\0';
-             p++);
+        p = text_delimiter(parsebuf);
         if (*p == '\0') {
             if (p != &rs->text.buffer[rs->text.offset]) {
                 fprintf(stderr, "File I/O: Read failed: null character "
@@ -397,7 +1108,7 @@ text_read(int fd,
             /* skip empty lines */
             continue;
         }
-        a[i++] = strtod(parsebuf, &p1);
+        a[i++] = text_parse(parsebuf, &p1);
         if (p1 == parsebuf) {
             fprintf(stderr, "File I/O: Read failed: bad text format.\n");
             errno = EIO;
@@ -429,6 +1140,13 @@ bfio_read(int fd,
     if (readstate[fd]->use_text) {
         return text_read(fd, &((uint8_t *)buf)[offset], count);
     }
+    if (readstate[fd]->use_map) {
+        sigset_t oldset;
+        block_stop_signals(&oldset);
+        retval = map_read(readstate[fd], &((uint8_t *)buf)[offset], count);
+        pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+        return retval;
+    }
  retry:
     if ((retval = read(fd, &((uint8_t *)buf)[offset], count)) == -1) {
         if (errno != EAGAIN && errno != EINTR) {
@@ -453,69 +1171,49 @@ bfio_read(int fd,
     return retval;
 }
 
+/* write as much of the formatted text as the file takes now */
 static int
-text_write_helper(int fd,
-                  int linelen)
+text_flush(int fd)
 {
-    int retval, i, partial, whole;
     struct writestate *ws;
-    struct iovec iovec[2];
+    int retval;
 
     ws = writestate[fd];
-    i = 0;
-    if (ws->text.partial_offset != 0) {
-        iovec[i].iov_base = &ws->text.partial_buffer[ws->text.partial_offset];
-        iovec[i].iov_len = linelen - ws->text.partial_offset;
-        i++;
-    }
-    if (ws->text.print_offset - ws->text.offset > 0) {
-        iovec[i].iov_base = &ws->text.buffer[ws->text.offset];
-        iovec[i].iov_len = ws->text.print_offset - ws->text.offset;
-        i++;
-    }
-    if (i == 0) {
-        return 0;
-    }
-    if ((retval = writev(fd, iovec, i)) == -1) {
-        if (errno != EAGAIN && errno != EINTR) {
-            fprintf(stderr, "File I/O: Write failed: %s.\n",
-                    strerror(errno));
-        }
-        return -1;
-    }
-    partial = 0;
-    if (ws->text.partial_offset != 0) {
-        if (ws->text.partial_offset + retval >= linelen) {
-            retval -= linelen - ws->text.partial_offset;
-            ws->text.partial_offset = 0;
-            partial = 1;
-        } else {
-            ws->text.partial_offset += retval;
-            errno = EAGAIN;
-            return -1;
+    while (ws->text.offset < ws->text.print_offset) {
+        if ((retval = write(fd, &ws->text.buffer[ws->text.offset],
+                            ws->text.print_offset - ws->text.offset)) == -1)
+        {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN) {
+                fprintf(stderr, "File I/O: Write failed: %s.\n",
+                        strerror(errno));
+                return -1;
+            }
+            break;
         }
+        ws->text.offset += retval;
     }
-    whole = retval / linelen;
-    ws->text.partial_offset = retval % linelen;
-    if (ws->text.partial_offset != 0) {
-        memcpy(ws->text.partial_buffer, &ws->text.buffer[whole * linelen],
-               linelen);
-        retval += linelen - ws->text.partial_offset;
-    }
-    ws->text.offset += retval;
     if (ws->text.offset == ws->text.print_offset) {
         ws->text.print_offset = 0;
         ws->text.offset = 0;
     }
-    return whole + partial;
+    return 0;
 }
 
+/*
+  The samples are formatted into the text buffer as long as there is room
+  for another line, and are then counted as written even if the file did
+  not take all of the text yet. What is left is written on the next call,
+  or when the module is stopped.
+*/
 static int
 text_write(int fd,
            const void *buf,
            int count)
 {
-    int retval, i, j, k, linelen;
+    int i, k, linemax;
     struct writestate *ws;
     const double *a;
     char *printbuf;
@@ -523,50 +1221,36 @@ text_write(int fd,
     ws = writestate[fd];
     count >>= 3;
     a = (const double *)buf;
-    if (ws->text.partial_offset != 0) {
-        a += ws->open_channels;
-        count -= ws->open_channels;
+    linemax = ws->open_channels * TEXT_MAXLEN;
+    if (text_flush(fd) == -1) {
+        return -1;
+    }
+    if (ws->text.print_offset + linemax > ws->text.bufsize &&
+        ws->text.offset > 0)
+    {
+        memmove(ws->text.buffer, &ws->text.buffer[ws->text.offset],
+                ws->text.print_offset - ws->text.offset);
+        ws->text.print_offset -= ws->text.offset;
+        ws->text.offset = 0;
     }
-    retval = 1;
     i = 0;
-    j = 0;
-    linelen = ws->open_channels * (outtext_len + 1);
-    while (i < count) {
-        if (ws->text.print_offset + linelen > ws->text.bufsize) {
-            if ((retval = text_write_helper(fd, linelen)) <= 0) {
-                if (retval == -1 && errno != EAGAIN && errno != EINTR) {
-                    return -1;
-                }
-                break;
-            }
-            j += retval;
-        } else {
-            printbuf = &ws->text.buffer[ws->text.print_offset];
-            for (k = 0; k < ws->open_channels; k++) {
-                sprintf(printbuf, OUTTEXT_FORMAT, a[i++]);
-                printbuf += outtext_len + 1;
-                printbuf[-1] = '\t';
-            }
-            printbuf[-1] = '\n';
-            ws->text.print_offset += linelen;
+    while (i < count && ws->text.print_offset + linemax <= ws->text.bufsize) {
+        printbuf = &ws->text.buffer[ws->text.print_offset];
+        for (k = 0; k < ws->open_channels; k++) {
+            printbuf += text_format(printbuf, a[i++]);
+            *printbuf++ = '\t';
         }
+        printbuf[-1] = '\n';
+        ws->text.print_offset = printbuf - ws->text.buffer;
     }
-    if ((retval > 0) &&
-        (ws->text.partial_offset != 0 || ws->text.print_offset != 0))
-    {
-        if ((retval = text_write_helper(fd, linelen)) <= 0) {
-            if (retval == -1 && errno != EAGAIN && errno != EINTR) {
-                return -1;
-            }
-            retval = 0;
-        }
-        j += retval;
+    if (text_flush(fd) == -1) {
+        return -1;
     }
-    if (j == 0) {
+    if (i == 0) {
         errno = EAGAIN;
         return -1;
     }
-    return ws->open_channels * (j << 3);
+    return i << 3;
 }
 
 int
@@ -580,6 +1264,14 @@ bfio_write(int fd,
     if (writestate[fd]->use_text) {
         return text_write(fd, &((const uint8_t *)buf)[offset], count);
     }
+    if (writestate[fd]->use_ring) {
+        sigset_t oldset;
+        block_stop_signals(&oldset);
+        retval = ring_write(writestate[fd], &((const uint8_t *)buf)[offset],
+                            count);
+        pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+        return retval;
+    }
     if ((retval = write(fd, &((const uint8_t *)buf)[offset], count)) == -1) {
         if (errno != EAGAIN && errno != EINTR) {
             fprintf(stderr, "File I/O: Write failed: %s.\n", strerror(errno));
@@ -598,11 +1290,45 @@ bfio_start(int io)
 void
 bfio_stop(int io)
 {
+    sigset_t oldset;
     int fd;
 
+    /* a signal arriving now would enter here again */
+    block_stop_signals(&oldset);
     for (fd = 0; fd <= fdmax[io]; fd++) {
-        if (FD_ISSET(fd, &fds[io])) {
-            close(fd);
+        if (!FD_ISSET(fd, &fds[io])) {
+            continue;
+        }
+        if (io == BF_IN && readstate[fd]->use_map &&
+            readstate[fd]->ra.started)
+        {
+            struct readahead *ra = &readstate[fd]->ra;
+            pthread_mutex_lock(&ra->mutex);
+            ra->stop = true;
+            pthread_cond_broadcast(&ra->cond);
+            pthread_mutex_unlock(&ra->mutex);
+            pthread_join(ra->thread, NULL);
+            ra->started = false;
+        }
+        if (io == BF_OUT && writestate[fd]->use_ring &&
+            writestate[fd]->wb.started)
+        {
+            /* the thread writes what is buffered before it ends */
+            struct writebehind *wb = &writestate[fd]->wb;
+            pthread_mutex_lock(&wb->mutex);
+            wb->stop = true;
+            pthread_cond_broadcast(&wb->cond);
+            pthread_mutex_unlock(&wb->mutex);
+            pthread_join(wb->thread, NULL);
+            wb->started = false;
+        }
+        if (io == BF_OUT && writestate[fd]->use_text) {
+            /* write the rest of the text, blocking if necessary */
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+            text_flush(fd);
         }
+        close(fd);
+        FD_CLR(fd, &fds[io]);
     }
+    pthread_sigmask(SIG_SETMASK, &oldset, NULL);
 }
@@ -93,15 +93,16 @@ static int
 buffersize_callback(jack_nframes_t nframes,
                     void *arg)
 {
-    const int period_size = (intptr_t)arg;
-    if (nframes == period_size) {
+    const int buffer_size = (intptr_t)arg;
+    if (nframes == buffer_size) {
         return 0;
     }
     fprintf(stderr, "\
 JACK I/O: JACK reported a changed buffer size to %d. Change is not supported.\n\
-  Make sure JACK has a fixed buffer size (called quantum if using Pipewire)\n\
-  that is the same as the BruteFIR partition size (currently %d).\n",
-            (int)nframes, period_size);
+  Make sure JACK has a fixed buffer size (called quantum if using Pipewire),\n\
+  preferably the same as the BruteFIR partition size, which gives the\n\
+  lowest I/O delay. The buffer size at startup was %d.\n",
+            (int)nframes, buffer_size);
     return -1;
 }
 
@@ -511,7 +512,7 @@ bfio_init(void *params,
     if (io == OUT && glob.hasio[IN]) {
         jack_set_latency_callback(glob.client, latency_callback, (void *)(intptr_t)period_size);
     }
-    jack_set_buffer_size_callback(glob.client, buffersize_callback, (void *)(intptr_t)period_size);
+    jack_set_buffer_size_callback(glob.client, buffersize_callback, (void *)(intptr_t)*device_period_size);
 
     return 0;
 }
@@ -68,6 +68,7 @@ static struct {
     bool debug;
     int sample_format_size;
     int expected_priority;
+    int quantum;
     struct pipewire_state *handles[2][BF_MAXCHANNELS];
     void **states[2];
     int n_handles[2];
@@ -88,6 +89,7 @@ static struct {
     .debug = false,
     .sample_format_size = 0,
     .expected_priority = -1,
+    .quantum = 0,
     .handles = {{NULL}},
     .states = {NULL, NULL},
     .n_handles = {0, 0},
@@ -417,7 +419,7 @@ create_and_connect_pipewire_filter(int period_size,
     char sample_rate_str[64];
     char quantum_str[64];
     snprintf(sample_rate_str, sizeof(sample_rate_str), "1/%u", sample_rate);
-    snprintf(quantum_str, sizeof(quantum_str), "%u", period_size);
+    snprintf(quantum_str, sizeof(quantum_str), "%u", glob.quantum);
     struct pw_filter *filter = pw_filter_new_simple(
         pw_main_loop_get_loop(glob.pw_loop),
         glob.client_name,
@@ -427,7 +429,7 @@ create_and_connect_pipewire_filter(int period_size,
             PW_KEY_MEDIA_ROLE, "DSP",
             PW_KEY_NODE_RATE, sample_rate_str,
             PW_KEY_NODE_FORCE_RATE, "0", // "0" means value of NODE_RATE is used
-            PW_KEY_NODE_FORCE_QUANTUM, quantum_str, // Quantum == period_size
+            PW_KEY_NODE_FORCE_QUANTUM, quantum_str, // Quantum == period_size unless configured
             NULL),
         &filter_events,
         NULL);
@@ -621,6 +623,18 @@ bfio_preinit(int *version_major,
             }
             glob.expected_priority = (int)lexval.real;
             GET_TOKEN(BF_LEX_EOS, "expected end of statement (;).\n");
+        } else if (strcmp(lexval.field, "quantum") == 0) {
+            GET_TOKEN(BF_LEXVAL_REAL, "expected integer.\n");
+            if ((int)lexval.real <= 0) {
+                fprintf(stderr, "PipeWire I/O: Invalid quantum %d.\n", (int)lexval.real);
+                return NULL;
+            }
+            if (glob.pw_loop != NULL && glob.quantum != (int)lexval.real) {
+                fprintf(stderr, "PipeWire I/O: quantum setting is global and must be set in the first pipewire device.\n");
+                return NULL;
+            }
+            glob.quantum = (int)lexval.real;
+            GET_TOKEN(BF_LEX_EOS, "expected end of statement (;).\n");
         }
     }
 
@@ -669,7 +683,10 @@ bfio_init(void *params,
 
     glob.process_cb = bf_process_callback;
     *isinterleaved = false;
-    *device_period_size = period_size;
+    if (glob.quantum == 0) {
+        glob.quantum = period_size;
+    }
+    *device_period_size = glob.quantum;
     struct pipewire_state *pws = (struct pipewire_state *)params;
 
     if (used_channels != open_channels) {
@@ -685,7 +702,7 @@ bfio_init(void *params,
             fprintf(stderr, "PipeWire I/O: Failed to init pipewire filter object.\n");
             return -1;
         }
-        int bufsize = period_size * bf_sampleformat_size(sample_format);
+        int bufsize = glob.quantum * bf_sampleformat_size(sample_format);
         glob.zerobuf = calloc(1, bufsize);
     }
 
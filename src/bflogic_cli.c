@@ -50,7 +50,7 @@ cffa -- change filter filter-input attenuation.\n\
         cffa <filter> <filter-input> <attenuation|Mmultiplier>\n\
 cfc  -- change filter coefficients.\n\
         cfc <filter> <coeff>\n\
-cfd  -- change filter delay. (may truncate coeffs!)\n\
+cfd  -- change filter delay. (may truncate coeffs beyond maxdelay!)\n\
         cfd <filter> <delay blocks>\n\
 cod  -- change output delay.\n\
         cod <output> <delay> [<subdelay>]\n\
@@ -73,7 +73,9 @@ sleep -- sleep for the given number of seconds [and ms], or blocks.\n\
          sleep 0 300 (sleep 300 milliseconds).\n\
 abort -- terminate immediately.\n\
 tp    -- toggle prompt.\n\
-ppk   -- print peak info, channels/samples/max dB.\n\
+ppk   -- print peak info, channels/samples/max dB. If there have been\n\
+         NaN/Inf or denormal values in the output, a second line\n\
+         prints channels/muted NaN/Inf blocks/denormal blocks.\n\
 rpk   -- reset peak meters.\n\
 upk   -- toggle print peak info on changes.\n\
 rti   -- print current realtime index.\n\
@@ -235,6 +237,7 @@ are_changes(void)
 static void
 print_overflows(FILE *stream)
 {
+    bool is_invalid = false;
     double peak;
     int n;
 
@@ -257,6 +260,21 @@ print_overflows(FILE *stream)
             fprintf(stream, "%d/%u/-Inf ", n,
                     (volatile unsigned int)bfaccess->overflow[n].n_overflows);
         }
+        if ((volatile unsigned int)bfaccess->overflow[n].n_nonfinite != 0 ||
+            (volatile unsigned int)bfaccess->overflow[n].n_denormals != 0)
+        {
+            is_invalid = true;
+        }
+    }
+    fprintf(stream, "\n");
+    if (!is_invalid) {
+        return;
+    }
+    fprintf(stream, "NaN/denormal blocks: ");
+    for (n = 0; n < n_channels[OUT]; n++) {
+        fprintf(stream, "%d/%u/%u ", n,
+                (volatile unsigned int)bfaccess->overflow[n].n_nonfinite,
+                (volatile unsigned int)bfaccess->overflow[n].n_denormals);
     }
     fprintf(stream, "\n");
 }
@@ -651,13 +669,20 @@ parse_command(FILE *stream,
         if (get_id(stream, cmd + 3, &cmd, &rid, FILTER_ID, -1) &&
             get_id(stream, cmd, &cmd, &id, COEFF_ID, rid))
         {
-            newstate.fctrl[rid].coeff = id;
-            newstate.fchanged[rid] = true;
+            if (!bfaccess->coeff_usable(rid, id)) {
+                fprintf(stream, "Filters with partition cannot use shared or "
+                        "processed coefficient sets.\n");
+            } else {
+                newstate.fctrl[rid].coeff = id;
+                newstate.fchanged[rid] = true;
+            }
         }
     } else if (strstr(cmd, "cfd") == cmd) {
         if (get_id(stream, cmd + 3, &cmd, &rid, FILTER_ID, -1)) {
             n = strtol(cmd, &p, 10);
-            if (cmd == p || n < 0 || n > n_maxblocks - 1) {
+            if (filters[rid].partition > 0) {
+                fprintf(stream, "Filters with partition cannot be delayed.\n");
+            } else if (cmd == p || n < 0 || n > n_maxblocks - 1 + filters[rid].maxdelay) {
                 fprintf(stream, "Invalid filter delay.\n");
             } else {
                 newstate.fctrl[rid].delayblocks = n;
@@ -16,7 +16,7 @@ extern "C" {
 #include <sys/time.h>
 #include <sched.h>
 
-#define BF_VERSION_MAJOR 3
+#define BF_VERSION_MAJOR 4
 #define BF_VERSION_MINOR 0
 
 /* limits */
@@ -101,6 +101,8 @@ struct bfoverflow {
     int32_t intlargest;
     double largest;
     double max;
+    unsigned int n_nonfinite; /* blocks muted due to NaN or Inf */
+    unsigned int n_denormals; /* blocks with denormal values */
 };
 
 struct bfcoeff {
@@ -123,6 +125,9 @@ struct bffilter {
     int *channels[2];
     int n_filters[2];
     int *filters[2];
+    int partition; /* partition length in samples, 0 means filter length */
+    int maxdelay; /* extra input ring blocks, delay may be up to
+                     n_blocks - 1 + maxdelay blocks */
 };
 
 struct bffilter_control {
@@ -187,6 +192,13 @@ struct bfaccess {
                         int subdelay);
     int (*get_subdelay)(int io,
                         int channel);
+
+/*
+ * Returns non-zero if the filter can use the coefficient set. Filters with a
+ * partition cannot use shared or processed coefficient sets.
+ */
+    int (*coeff_usable)(int filter,
+                        int coeff);
 };
 
 struct bfevents {
@@ -112,6 +112,9 @@ struct intercomm_area {
     volatile int exit_status;
     volatile wordbool_t full_proc[BF_MAXPROCESSES];
     volatile wordbool_t ignore_rtprio;
+    volatile wordbool_t output_xfade[BF_MAXCHANNELS];
+    volatile wordbool_t output_fd[BF_MAXCHANNELS];
+    volatile wordbool_t output_td[BF_MAXCHANNELS];
 
     struct {
         uint64_t ts_start;
@@ -268,14 +271,14 @@ print_debug(void)
                  i < D.o[n].dai_loops && i < DEBUG_MAX_DAI_LOOPS;
                  i++)
             {
-                printf("    %" PRIu64 "\tcall select fdmax %d\n",
-                       (u64_t)((D.o[n].d[i].select.ts_call -
+                printf("    %" PRIu64 "\tcall wait timeout %d\n",
+                       (u64_t)((D.o[n].d[i].wait.ts_call -
                                 D.ts_start) / tsdiv),
-                       D.o[n].d[i].select.fdmax);
+                       D.o[n].d[i].wait.timeout);
                 printf("    %" PRIu64 "\tret %d\n",
-                       (u64_t)((D.o[n].d[i].select.ts_ret -
+                       (u64_t)((D.o[n].d[i].wait.ts_ret -
                                 D.ts_start) / tsdiv),
-                       D.o[n].d[i].select.retval);
+                       D.o[n].d[i].wait.retval);
                 printf("    %" PRIu64 "\twrite(%d, %p, %d, %d)\n",
                        (u64_t)((D.o[n].d[i].write.ts_call -
                                 D.ts_start) / tsdiv),
@@ -328,14 +331,14 @@ print_debug(void)
              i < D.i[n].dai_loops && i < DEBUG_MAX_DAI_LOOPS;
              i++)
         {
-            printf("    %" PRIu64 "\tcall select fdmax %d\n",
-                   (u64_t)((D.i[n].d[i].select.ts_call - D.ts_start) / tsdiv),
-                   D.i[n].d[i].select.fdmax);
+            printf("    %" PRIu64 "\tcall wait timeout %d\n",
+                   (u64_t)((D.i[n].d[i].wait.ts_call - D.ts_start) / tsdiv),
+                   D.i[n].d[i].wait.timeout);
             printf("    %" PRIu64 "\tret %d (%" PRIu64 ")\n",
-                   (u64_t)((D.i[n].d[i].select.ts_ret - D.ts_start) / tsdiv),
-                   D.i[n].d[i].select.retval,
-                   (u64_t)((D.i[n].d[i].select.ts_ret - D.ts_start) / tsdiv -
-                           (D.i[n].d[i].select.ts_call - D.ts_start) / tsdiv));
+                   (u64_t)((D.i[n].d[i].wait.ts_ret - D.ts_start) / tsdiv),
+                   D.i[n].d[i].wait.retval,
+                   (u64_t)((D.i[n].d[i].wait.ts_ret - D.ts_start) / tsdiv -
+                           (D.i[n].d[i].wait.ts_call - D.ts_start) / tsdiv));
             printf("    %" PRIu64 "\tread(%d, %p, %d, %d)\n",
                    (u64_t)((D.i[n].d[i].read.ts_call - D.ts_start) / tsdiv),
                    D.i[n].d[i].read.fd,
@@ -410,12 +413,12 @@ print_debug(void)
              i < D.o[n].dai_loops && i < DEBUG_MAX_DAI_LOOPS;
              i++)
         {
-            printf("    %" PRIu64 "\tcall select fdmax %d\n",
-                   (u64_t)((D.o[n].d[i].select.ts_call - D.ts_start) / tsdiv),
-                   D.o[n].d[i].select.fdmax);
+            printf("    %" PRIu64 "\tcall wait timeout %d\n",
+                   (u64_t)((D.o[n].d[i].wait.ts_call - D.ts_start) / tsdiv),
+                   D.o[n].d[i].wait.timeout);
             printf("    %" PRIu64 "\tret %d\n",
-                   (u64_t)((D.o[n].d[i].select.ts_ret - D.ts_start) / tsdiv),
-                   D.o[n].d[i].select.retval);
+                   (u64_t)((D.o[n].d[i].wait.ts_ret - D.ts_start) / tsdiv),
+                   D.o[n].d[i].wait.retval);
             int k;
             if (D.o[n-1].dai_loops > DEBUG_MAX_DAI_LOOPS) {
                 k = DEBUG_MAX_DAI_LOOPS - 1;
@@ -548,14 +551,36 @@ get_subdelay(int io,
     return icomm->subdelay[io][channel];
 }
 
+static int
+coeff_usable(int filter,
+             int coeff)
+{
+    int i;
+
+    if (filter < 0 || filter >= bfconf->n_filters || coeff >= bfconf->n_coeffs) {
+        return false;
+    }
+    if (coeff < 0 || bfconf->filters[filter].partition == 0) {
+        return true;
+    }
+    for (i = 0; bfconf->partsizes[i] != bfconf->filters[filter].partition; i++);
+    return bfconf->coeffs_part[i * bfconf->n_coeffs + coeff] != NULL;
+}
+
 static void
 print_overflows(void)
 {
-    bool is_overflow = false;
+    bool is_overflow = false, is_invalid = false;
     for (int n = 0; n < bfconf->n_channels[OUT]; n++) {
-        if (icomm->overflow[n].n_overflows > 0) {
+        if (icomm->overflow[n].n_overflows > 0 ||
+            icomm->overflow[n].n_nonfinite > 0)
+        {
             is_overflow = true;
-            break;
+        }
+        if (icomm->overflow[n].n_nonfinite > 0 ||
+            icomm->overflow[n].n_denormals > 0)
+        {
+            is_invalid = true;
         }
     }
     if (!is_overflow && !bfconf->show_progress) {
@@ -577,6 +602,25 @@ print_overflows(void)
         }
     }
     pinfo("\n");
+    if (is_invalid) {
+        pinfo("NaN/denormal blocks: ");
+        for (int n = 0; n < bfconf->n_channels[OUT]; n++) {
+            pinfo("%d/%u/%u ", n, icomm->overflow[n].n_nonfinite,
+                  icomm->overflow[n].n_denormals);
+        }
+        pinfo("\n");
+    }
+}
+
+/* denormal counts may change every block, and are not warned about */
+static bool
+overflow_changed(const struct bfoverflow *a,
+                 const struct bfoverflow *b)
+{
+    return a->n_overflows != b->n_overflows ||
+        a->intlargest != b->intlargest ||
+        a->largest != b->largest ||
+        a->n_nonfinite != b->n_nonfinite;
 }
 
 static void
@@ -587,7 +631,7 @@ check_overflows(struct bfoverflow overflow[])
     }
     for (int n = 0; n < bfconf->n_channels[OUT]; n++) {
         struct bfoverflow of = icomm->overflow[n];
-        if (memcmp(&of, &overflow[n], sizeof(struct bfoverflow)) != 0) {
+        if (overflow_changed(&of, &overflow[n])) {
             for (; n < bfconf->n_channels[OUT]; n++) {
                 overflow[n] = icomm->overflow[n];
             }
@@ -942,12 +986,395 @@ synch_filter_processes(bf_sem_t *filter_readfd,
     }
 }
 
+static bool
+filter_td_capable(const struct bffilter *filter)
+{
+    /* filters connected to other filters, or where logic modules need
+       access to the frequency-domain, are never run in the time-domain */
+    return filter->n_channels[IN] > 0 &&
+        filter->n_filters[IN] == 0 &&
+        filter->n_filters[OUT] == 0 &&
+        !filter->crossfade &&
+        events.n_input_freqd == 0 &&
+        events.n_pre_convolve == 0 &&
+        events.n_post_convolve == 0 &&
+        events.n_output_freqd == 0;
+}
+
+/* find out which filters that can contribute to any unmuted output, must
+   be called with the icomm mutex held */
+static void
+filter_liveness(bool live[],
+                uint32_t ismuted[BF_MAXCHANNELS/32])
+{
+    const struct bffilter *filter, *dest;
+    bool changed;
+    int n, i, j, k;
+
+    if (events.n_pre_convolve > 0 || events.n_post_convolve > 0) {
+        /* logic modules may look at the output of any filter */
+        for (n = 0; n < bfconf->n_filters; n++) {
+            live[n] = true;
+        }
+        return;
+    }
+    memset(live, 0, bfconf->n_filters * sizeof(bool));
+    do {
+        changed = false;
+        for (n = 0; n < bfconf->n_filters; n++) {
+            if (live[n]) {
+                continue;
+            }
+            filter = &bfconf->filters[n];
+            /* partitioned filters have state of their own and are always run */
+            live[n] = filter->partition > 0;
+            for (i = 0; i < filter->n_channels[OUT] && !live[n]; i++) {
+                live[n] = !bit32_isset(ismuted, filter->channels[OUT][i]) &&
+                    icomm->fctrl[n].scale[OUT][i] != 0.0;
+            }
+            for (i = 0; i < filter->n_filters[OUT] && !live[n]; i++) {
+                k = filter->filters[OUT][i];
+                if (!live[k]) {
+                    continue;
+                }
+                dest = &bfconf->filters[k];
+                for (j = 0; j < dest->n_filters[IN]; j++) {
+                    if (dest->filters[IN][j] == n && icomm->fctrl[k].fscale[j] != 0.0) {
+                        live[n] = true;
+                        break;
+                    }
+                }
+            }
+            if (live[n]) {
+                changed = true;
+            }
+        }
+    } while (changed);
+}
+
+static bool
+filter_td_mode(bool td_capable,
+               int coeff,
+               int delayblocks)
+{
+    /* the hidden coefficient sets after the ordinary ones are never run in
+       the time-domain */
+    return td_capable && delayblocks <= 0 &&
+        (coeff < 0 ||
+         (coeff < bfconf->n_coeffs &&
+          (bfconf->coeffs_dirac_pos[coeff] >= 0 || bfconf->coeffs_td[coeff] != NULL)));
+}
+
+/* state of a filter with a longer partition than the filter length */
+struct part_state {
+    int k;          /* partition length in periods */
+    int blocklen;   /* partition length in samples */
+    int phase;      /* offset in periods, to spread transforms among filters */
+    int pi;         /* partition length index in bfconf */
+    int n_hist;
+    int newest;
+    int acc_coeff;
+    int acc_next;   /* next tail partition to add to the accumulator */
+    void *overlap;  /* time-domain input, previous and current partition */
+    void **hist;    /* transformed input partitions */
+    void *acc;      /* transformed output accumulator */
+    void *out;      /* time-domain output of the latest partition */
+};
+
+static struct part_state *
+part_state_new(const struct bffilter *filter)
+{
+    struct part_state *ps;
+    int n, size;
+
+    ps = emalloc(sizeof(struct part_state));
+    memset(ps, 0, sizeof(struct part_state));
+    ps->blocklen = filter->partition;
+    ps->k = filter->partition / bfconf->filter_length;
+    for (n = 0; n < filter->intname; n++) {
+        if (bfconf->filters[n].partition == filter->partition) {
+            ps->phase++;
+        }
+    }
+    ps->phase %= ps->k;
+    for (ps->pi = 0; bfconf->partsizes[ps->pi] != filter->partition; ps->pi++);
+    ps->n_hist = 1;
+    for (n = 0; n < bfconf->n_coeffs; n++) {
+        if (bfconf->coeffs_part_n[ps->pi * bfconf->n_coeffs + n] > ps->n_hist) {
+            ps->n_hist = bfconf->coeffs_part_n[ps->pi * bfconf->n_coeffs + n];
+        }
+    }
+    ps->acc_coeff = bfconf->initfctrl[filter->intname].coeff;
+    ps->acc_next = 1;
+    size = 2 * ps->blocklen * bfconf->realsize;
+    ps->overlap = emallocaligned(size);
+    memset(ps->overlap, 0, size);
+    ps->acc = emallocaligned(size);
+    memset(ps->acc, 0, size);
+    ps->out = emallocaligned(size / 2);
+    memset(ps->out, 0, size / 2);
+    ps->hist = emalloc(ps->n_hist * sizeof(void *));
+    for (n = 0; n < ps->n_hist; n++) {
+        ps->hist[n] = emallocaligned(size);
+        memset(ps->hist[n], 0, size);
+    }
+    return ps;
+}
+
+static void
+part_accumulate(struct part_state *ps,
+                void **coeffs,
+                int n_parts,
+                int n_max)
+{
+    int j;
+
+    for (; ps->acc_next < n_parts && n_max > 0; ps->acc_next++, n_max--) {
+        j = (ps->newest + 1 - ps->acc_next + ps->n_hist) % ps->n_hist;
+        convolver_part_convolve_add(ps->hist[j], coeffs[ps->acc_next], ps->acc, ps->blocklen);
+    }
+}
+
+/* Process one period of a filter with a longer partition. The input is
+   collected until a full partition is available, which is then transformed
+   and convolved, while the tail of the next partition is spread over the
+   periods in between. The output is delayed with one partition less one
+   period. */
+static void
+part_process(struct part_state *ps,
+             void *input_bufs[],
+             double scales[],
+             int n_inputs,
+             int coeff,
+             unsigned int blockcounter,
+             void *output_buf)
+{
+    const int realsize = bfconf->realsize;
+    const int fragsize = bfconf->filter_length;
+    void **coeffs = NULL;
+    int m, n_parts = 1;
+
+    m = (int)((blockcounter + (unsigned int)ps->phase) % (unsigned int)ps->k);
+    convolver_td_mixnscale(input_bufs,
+                           &((uint8_t *)ps->overlap)[(ps->blocklen + m * fragsize) * realsize],
+                           scales,
+                           n_inputs,
+                           fragsize);
+    if (coeff >= 0 && bfconf->coeffs_part[ps->pi * bfconf->n_coeffs + coeff] == NULL) {
+        /* shared or processed coefficient sets are not available, and
+           refused by coeff_usable(), but a logic module may still have set
+           one, then the current coefficient set is kept */
+        coeff = ps->acc_coeff;
+    }
+    if (coeff >= 0) {
+        coeffs = bfconf->coeffs_part[ps->pi * bfconf->n_coeffs + coeff];
+        n_parts = bfconf->coeffs_part_n[ps->pi * bfconf->n_coeffs + coeff];
+    }
+    if (coeff != ps->acc_coeff) {
+        memset(ps->acc, 0, 2 * ps->blocklen * realsize);
+        ps->acc_next = 1;
+        ps->acc_coeff = coeff;
+    }
+    if (m < ps->k - 1) {
+        if (coeffs != NULL) {
+            part_accumulate(ps, coeffs, n_parts, (n_parts + ps->k - 3) / (ps->k - 1));
+        }
+    } else {
+        if (coeffs != NULL) {
+            part_accumulate(ps, coeffs, n_parts, n_parts);
+        }
+        ps->newest = (ps->newest + 1) % ps->n_hist;
+        memcpy(ps->hist[ps->newest], ps->overlap, 2 * ps->blocklen * realsize);
+        memcpy(ps->overlap, &((uint8_t *)ps->overlap)[ps->blocklen * realsize],
+               ps->blocklen * realsize);
+        if (coeff < 0) {
+            memcpy(ps->out, &((uint8_t *)ps->hist[ps->newest])[ps->blocklen * realsize],
+                   ps->blocklen * realsize);
+            convolver_part_time2freq(ps->hist[ps->newest], ps->blocklen);
+        } else {
+            convolver_part_time2freq(ps->hist[ps->newest], ps->blocklen);
+            convolver_part_convolve_add(ps->hist[ps->newest], coeffs[0], ps->acc, ps->blocklen);
+            convolver_part_freq2time(ps->acc, ps->blocklen);
+            memcpy(ps->out, ps->acc, ps->blocklen * realsize);
+        }
+        memset(ps->acc, 0, 2 * ps->blocklen * realsize);
+        ps->acc_next = 1;
+    }
+    memcpy(output_buf, &((uint8_t *)ps->out)[((m + 1) % ps->k) * fragsize * realsize],
+           fragsize * realsize);
+}
+
+/* Interleaved channels handled by a filter process are copied to/from
+   contiguous staging buffers for all channels at once, a tile of frames at a
+   time, so each part of the interleaved buffer is brought into cache once
+   instead of once per channel. */
+#define STAGE_TILE_BYTES 8192
+
+struct stage {
+    int n_channels;
+    int tile;                               /* frames per tile */
+    int physch[BF_MAXCHANNELS];
+    void *buf[BF_MAXCHANNELS];              /* indexed as physch */
+    struct buffer_format bf[BF_MAXCHANNELS];/* indexed as physch */
+};
+
+static inline void
+strided_copy(uint8_t *dst,
+             int dst_step,
+             const uint8_t *src,
+             int src_step,
+             int bytes,
+             int n_samples)
+{
+    int n;
+
+    switch (bytes) {
+    case 1:
+        for (n = 0; n < n_samples; n++, dst += dst_step, src += src_step) {
+            *dst = *src;
+        }
+        break;
+    case 2:
+        for (n = 0; n < n_samples; n++, dst += dst_step, src += src_step) {
+            memcpy(dst, src, 2);
+        }
+        break;
+    case 3:
+        for (n = 0; n < n_samples; n++, dst += dst_step, src += src_step) {
+            memcpy(dst, src, 3);
+        }
+        break;
+    case 4:
+        for (n = 0; n < n_samples; n++, dst += dst_step, src += src_step) {
+            memcpy(dst, src, 4);
+        }
+        break;
+    default:
+        for (n = 0; n < n_samples; n++, dst += dst_step, src += src_step) {
+            memcpy(dst, src, 8);
+        }
+        break;
+    }
+}
+
+static void
+stage_init(struct stage *st,
+           int io,
+           const int channels[],
+           int n_channels)
+{
+    struct buffer_format *bf;
+    int n, i, physch, framesize = 1;
+
+    memset(st->buf, 0, sizeof(st->buf));
+    st->n_channels = 0;
+    for (n = 0; n < n_channels; n++) {
+        physch = bfconf->virt2phys[io][channels[n]];
+        bf = &dai_buffer_format[io]->bf[physch];
+        if (bf->sample_spacing == 1) {
+            continue;
+        }
+        for (i = 0; i < st->n_channels && st->physch[i] != physch; i++);
+        if (i == st->n_channels) {
+            st->physch[st->n_channels++] = physch;
+            if (bf->sample_spacing * bf->sf.bytes > framesize) {
+                framesize = bf->sample_spacing * bf->sf.bytes;
+            }
+        }
+    }
+    if (st->n_channels < 2) {
+        /* nothing to gain from a single channel */
+        st->n_channels = 0;
+        return;
+    }
+    st->tile = STAGE_TILE_BYTES / framesize;
+    if (st->tile < 4) {
+        st->tile = 4;
+    }
+    for (n = 0; n < st->n_channels; n++) {
+        physch = st->physch[n];
+        bf = &dai_buffer_format[io]->bf[physch];
+        st->buf[physch] = emallocaligned(bfconf->filter_length * bf->sf.bytes);
+        memset(st->buf[physch], 0, bfconf->filter_length * bf->sf.bytes);
+        st->bf[physch].sf = bf->sf;
+        st->bf[physch].sample_spacing = 1;
+        st->bf[physch].byte_offset = 0;
+    }
+}
+
+/* the buffer and format to use for a physical channel */
+static inline void *
+stage_buf(struct stage *st,
+          int physch,
+          void *iobuf)
+{
+    return st->buf[physch] != NULL ? st->buf[physch] : iobuf;
+}
+
+static inline struct buffer_format *
+stage_bf(struct stage *st,
+         int io,
+         int physch)
+{
+    return st->buf[physch] != NULL ? &st->bf[physch] :
+        &dai_buffer_format[io]->bf[physch];
+}
+
+/* with synchronous callback I/O the channels are read and written directly
+   in the sound server's buffers, which move every period */
+static void
+stage_direct(struct stage *st,
+             int io,
+             const int channels[],
+             int n_channels)
+{
+    int n, physch;
+
+    for (n = 0; n < n_channels; n++) {
+        physch = bfconf->virt2phys[io][channels[n]];
+        st->buf[physch] = dai_callback_buffer(io, physch);
+        st->bf[physch].sf = dai_buffer_format[io]->bf[physch].sf;
+        st->bf[physch].sample_spacing = 1;
+        st->bf[physch].byte_offset = 0;
+    }
+}
+
+static void
+stage_transpose(struct stage *st,
+                int io,
+                void *iobuf)
+{
+    struct buffer_format *bf;
+    uint8_t *p;
+    int n, i, m, stride;
+
+    for (n = 0; n < bfconf->filter_length; n += st->tile) {
+        m = bfconf->filter_length - n < st->tile ? bfconf->filter_length - n : st->tile;
+        for (i = 0; i < st->n_channels; i++) {
+            bf = &dai_buffer_format[io]->bf[st->physch[i]];
+            stride = bf->sample_spacing * bf->sf.bytes;
+            p = &((uint8_t *)iobuf)[bf->byte_offset + n * stride];
+            if (io == IN) {
+                strided_copy(&((uint8_t *)st->buf[st->physch[i]])[n * bf->sf.bytes],
+                             bf->sf.bytes, p, stride, bf->sf.bytes, m);
+            } else {
+                strided_copy(p, stride,
+                             &((uint8_t *)st->buf[st->physch[i]])[n * bf->sf.bytes],
+                             bf->sf.bytes, bf->sf.bytes, m);
+            }
+        }
+    }
+}
+
 struct filter_process_args {
     struct bfaccess *bfaccess;
     void *inbuf[2];
     void *outbuf[2];
     void **input_freqcbuf; // array
+    void *(*input_timecbuf)[2]; // array
     void **output_freqcbuf; // array
+    void **output_xfadecbuf; // array, NULL if no filter crossfades
+    void **output_timecbuf; // array, NULL if no direct FIR filtering
     bf_sem_t *filter_readfd;
     bf_sem_t **filter_writefd; // array
     bf_sem_t *input_readfd;
@@ -978,7 +1405,10 @@ filter_process(struct filter_process_args *a)
     void *inbuf[2] = { a->inbuf[0], a->inbuf[1] };
     void *outbuf[2] = { a->outbuf[0], a->outbuf[1] };
     void **input_freqcbuf = a->input_freqcbuf;
+    void *(*input_timecbuf)[2] = a->input_timecbuf;
     void **output_freqcbuf = a->output_freqcbuf;
+    void **output_xfadecbuf = a->output_xfadecbuf;
+    void **output_timecbuf = a->output_timecbuf;
     bf_sem_t *filter_readfd = a->filter_readfd;
     bf_sem_t **filter_writefd = a->filter_writefd;
     bf_sem_t *input_readfd = a->input_readfd;
@@ -1008,10 +1438,12 @@ filter_process(struct filter_process_args *a)
     int curblock = 0;
     int curbuf = 0;
 
-    void *input_timecbuf[n_procinputs][2];
     void **mixconvbuf_inputs[n_filters];
     void **mixconvbuf_filters[n_filters];
-    void *cbuf[n_filters][n_blocks];
+    void **cbuf[n_filters];
+    int n_ring[n_filters];
+    int prevdelay[n_filters];
+    int n_ringblocks;
     void *ocbuf[n_filters];
     void *evalbuf[n_filters];
     void *static_evalbuf = NULL;
@@ -1021,8 +1453,37 @@ filter_process(struct filter_process_args *a)
     double scales[n_filters + BF_MAXCHANNELS];
     double virtscales[2][BF_MAXCHANNELS];
     void *crossfadebuf[2];
+    void *xfadebuf[n_filters];
+    void *xfconvbuf[n_filters];
+    void *xfbuf = NULL;
+    void *tdbuf[n_filters];
+    struct part_state *pstate[n_filters];
+    int fuse_local[n_filters];
+    bool fusemode[n_filters];
+    bool fuse_skip[n_filters];
+    bool fused;
+    int cse_local[n_filters];
+    bool csemode[n_filters];
+    void *tdinbufs[BF_MAXCHANNELS];
+    void *tdconvbuf[n_filters];
+    void *fdconvbuf[n_filters];
+    double tdscales[n_filters];
+    void *tdaddbufs[2];
+    double tdaddscales[2] = { 1.0, 1.0 };
+    delaybuffer_t *gain_db[n_filters];
+    double gain;
+    int maxpos;
+    void *taps;
+    int n_taps, n_td, n_fd;
+    int *input_users[n_procinputs];
+    int n_input_users[n_procinputs];
+    bool td_capable_all[bfconf->n_filters];
+    bool own_filter[bfconf->n_filters];
+    int icomm_coeff_all[bfconf->n_filters];
+    bool live_all[bfconf->n_filters];
+    int icomm_delayblocks_all[bfconf->n_filters];
+    bool fft_needed;
     void *mixbuf = NULL;
-    void *outconvbuf[BF_MAXCHANNELS][n_filters];
     int outconvbuf_n_filters[BF_MAXCHANNELS];
     unsigned int blockcounter = 0;
     delaybuffer_t *output_db[BF_MAXCHANNELS];
@@ -1032,10 +1493,17 @@ filter_process(struct filter_process_args *a)
     bool need_crossfadebuf = false;
     bool need_mixbuf = false;
     bool mixbuf_is_filled;
+    void *virtmixbufs[BF_MAXCHANNELS + 1];
+    double virtmixscales[BF_MAXCHANNELS + 1];
+    bool fdmix;
+    bool sdfold = false, sdfold_now;
+    int k, n_virt;
     int inbuf_copy_size;
 
-    int n, i, j, coeff, delay, cblocks, prevcblocks, physch, virtch;
+    int n, i, j, coeff, delay, cblocks, prevcblocks, physch, virtch, n_xfade, n_tdbufs;
     struct buffer_format *bf, inbuf_copy_bf;
+    struct stage stage[2];
+    void *ibuf;
     uint8_t *memptr, *baseptr;
     struct bfoverflow of;
     uint32_t dummydata32;
@@ -1056,10 +1524,14 @@ filter_process(struct filter_process_args *a)
     int outconvbuf_map[BF_MAXCHANNELS][n_filters];
     bool input_freqcbuf_zero[bfconf->n_channels[IN]];
     bool output_freqcbuf_zero[bfconf->n_channels[OUT]];
-    bool cbuf_zero[n_filters][n_blocks];
+    bool *cbuf_zero[n_filters];
     bool ocbuf_zero[n_filters];
     bool evalbuf_zero[n_filters];
+    bool xfading[n_filters];
+    bool td_capable[n_filters];
+    bool tdmode[n_filters];
     bool temp_buffer_zero;
+    bool xfade;
     bool iszero;
 
     struct timeval period_start, period_end, tv;
@@ -1083,7 +1555,22 @@ filter_process(struct filter_process_args *a)
     memset(partial_proc, 0xFF, (n_filters / 32 + 1) * sizeof(uint32_t));
     memset(evalbuf_zero, 0, n_filters * sizeof(bool));
     memset(ocbuf_zero, 0, n_filters * sizeof(bool));
-    memset(cbuf_zero, 0, n_blocks * n_filters * sizeof(bool));
+    memset(xfading, 0, n_filters * sizeof(bool));
+    memset(tdmode, 0, n_filters * sizeof(bool));
+    /* filters with a maxdelay get a longer ring of input blocks, so delayed
+       filters need not be truncated. Partitioned filters keep their input in
+       a state of their own, so their ring is not allocated */
+    n_ringblocks = 0;
+    for (n = 0; n < n_filters; n++) {
+        n_ring[n] = filters[n].partition > 0 ? 1 : n_blocks + filters[n].maxdelay;
+        prevdelay[n] = 0;
+        cbuf[n] = alloca(n_ring[n] * sizeof(void *));
+        cbuf_zero[n] = alloca(n_ring[n] * sizeof(bool));
+        memset(cbuf_zero[n], 0, n_ring[n] * sizeof(bool));
+        if (filters[n].partition == 0) {
+            n_ringblocks += n_ring[n];
+        }
+    }
     memset(output_freqcbuf_zero, 0, bfconf->n_channels[OUT] * sizeof(bool));
     memset(input_freqcbuf_zero, 0, bfconf->n_channels[IN] * sizeof(bool));
     memset(crossfadebuf, 0, sizeof(crossfadebuf));
@@ -1161,13 +1648,30 @@ filter_process(struct filter_process_args *a)
         }
     }
 
+    stage_init(&stage[IN], IN, procinputs, n_procinputs);
+    stage_init(&stage[OUT], OUT, procoutputs, n_procoutputs);
+
     /* find out if there is a need of evaluation buffers, and how many,
-       and if there is a need for a crossfade buffer */
-    for (n = i = j = 0; n < n_filters; n++) {
+       and if there is a need for crossfade buffers. Filters which output
+       only to channels are crossfaded in the time-domain after the output
+       transform, which may be done by any process, so if any filter in the
+       system crossfades all processes need the crossfade buffers. */
+    for (n = i = j = n_xfade = n_tdbufs = 0; n < n_filters; n++) {
         if (filters[n].n_filters[IN] > 0) {
             i++;
         }
-        if (filters[n].crossfade) {
+        td_capable[n] = output_timecbuf != NULL && filter_td_capable(&filters[n]);
+        if (td_capable[n] || filters[n].partition > 0) {
+            n_tdbufs++;
+        }
+        if (filters[n].crossfade && filters[n].n_filters[OUT] == 0 &&
+            output_xfadecbuf != NULL)
+        {
+            n_xfade++;
+        }
+    }
+    for (n = 0; n < bfconf->n_filters; n++) {
+        if (bfconf->filters[n].crossfade) {
             need_crossfadebuf = true;
         }
     }
@@ -1181,14 +1685,16 @@ filter_process(struct filter_process_args *a)
         bf_exit(BF_EXIT_OTHER);
     }
     if (n_blocks > 1) {
-        memsize = n_filters * n_blocks * convbufsize +
+        memsize = n_ringblocks * convbufsize +
             n_filters * convbufsize +
             i * (convbufsize + convbufsize / 2) +
-            2 * n_procinputs * convbufsize;
+            n_xfade * convbufsize +
+            n_tdbufs * (convbufsize / 2);
     } else {
         memsize = n_filters * convbufsize +
             i * (convbufsize + convbufsize / 2) +
-            2 * n_procinputs * convbufsize;
+            n_xfade * convbufsize +
+            n_tdbufs * (convbufsize / 2);
     }
     if (i > 0) {
         memsize += convbufsize;
@@ -1228,7 +1734,7 @@ filter_process(struct filter_process_args *a)
     }
     if (n_blocks > 1) {
         for (n = 0; n < n_filters; n++) {
-            for (i = 0; i < n_blocks; i++) {
+            for (i = 0; i < n_ring[n] && filters[n].partition == 0; i++) {
                 cbuf[n][i] = memptr;
                 memptr += convbufsize;
             }
@@ -1254,9 +1760,64 @@ filter_process(struct filter_process_args *a)
         }
     }
     inbuf_copy = ocbuf[0];
-    for (n = 0; n < n_procinputs; n++, memptr += 2 * convbufsize) {
-        input_timecbuf[n][0] = memptr;
-        input_timecbuf[n][1] = memptr + convbufsize;
+    /* buffers for the previous coefficient set output of crossfading filters */
+    for (n = 0; n < n_filters; n++) {
+        if (filters[n].crossfade && filters[n].n_filters[OUT] == 0 &&
+            output_xfadecbuf != NULL)
+        {
+            xfadebuf[n] = memptr;
+            memptr += convbufsize;
+        } else {
+            xfadebuf[n] = NULL;
+        }
+    }
+    /* output buffers of filters which may be run in the time-domain */
+    for (n = 0; n < n_filters; n++) {
+        tdbuf[n] = NULL;
+        pstate[n] = NULL;
+        if (filters[n].partition > 0) {
+            tdbuf[n] = memptr;
+            memptr += convbufsize / 2;
+            pstate[n] = part_state_new(&filters[n]);
+        } else if (td_capable[n]) {
+            tdbuf[n] = memptr;
+            memptr += convbufsize / 2;
+        }
+    }
+    /* delay buffers for filters which may run coefficient sets which are
+       a delayed dirac pulse, when the delay is longer than a block */
+    for (n = maxpos = 0; n < bfconf->n_coeffs; n++) {
+        if (bfconf->coeffs_dirac_pos[n] > maxpos) {
+            maxpos = bfconf->coeffs_dirac_pos[n];
+        }
+    }
+    for (n = 0; n < n_filters; n++) {
+        if (td_capable[n] && maxpos > fragsize) {
+            gain_db[n] = delay_allocate_buffer(fragsize, 0, maxpos, bfconf->realsize);
+        } else {
+            gain_db[n] = NULL;
+        }
+    }
+    /* for each input, find out which filters in any process that use it, so
+       we know if it needs to be transformed to the frequency-domain */
+    for (n = 0; n < bfconf->n_filters; n++) {
+        td_capable_all[n] = output_timecbuf != NULL && filter_td_capable(&bfconf->filters[n]);
+        own_filter[n] = false;
+    }
+    for (n = 0; n < n_filters; n++) {
+        own_filter[filters[n].intname] = true;
+    }
+    for (n = 0; n < n_procinputs; n++) {
+        input_users[n] = alloca(bfconf->n_filters * sizeof(int));
+        n_input_users[n] = 0;
+        for (i = 0; i < bfconf->n_filters; i++) {
+            for (j = 0; j < bfconf->filters[i].n_channels[IN]; j++) {
+                if (bfconf->filters[i].channels[IN][j] == procinputs[n]) {
+                    input_users[n][n_input_users[n]++] = i;
+                    break;
+                }
+            }
+        }
     }
     /* for each filter, find out which channel-inputs that are mixed */
     for (n = 0; n < n_filters; n++) {
@@ -1274,6 +1835,30 @@ filter_process(struct filter_process_args *a)
             mixconvbuf_inputs[n][i] = input_freqcbuf[filters[n].channels[IN][i]];
         }
     }
+    /* for each filter which may be fused with its source filter, find the
+       local index of the source */
+    for (n = 0; n < n_filters; n++) {
+        fuse_local[n] = -1;
+        fusemode[n] = false;
+        for (i = 0; i < n_filters && bfconf->fuse_src[filters[n].intname] != -1; i++) {
+            if (filters[i].intname == bfconf->fuse_src[filters[n].intname]) {
+                fuse_local[n] = i;
+                break;
+            }
+        }
+    }
+    /* for each filter which computes the same as an earlier filter, find
+       the local index of that filter */
+    for (n = 0; n < n_filters; n++) {
+        cse_local[n] = -1;
+        csemode[n] = false;
+        for (i = 0; i < n && bfconf->cse_master[filters[n].intname] != -1; i++) {
+            if (filters[i].intname == bfconf->cse_master[filters[n].intname]) {
+                cse_local[n] = i;
+                break;
+            }
+        }
+    }
     /* for each filter, find out which filter-inputs that are mixed */
     for (n = 0; n < n_filters; n++) {
         prevcoeff[n] = icomm->fctrl[filters[n].intname].coeff;
@@ -1303,7 +1888,6 @@ filter_process(struct filter_process_args *a)
             for (j = 0; j < filters[i].n_channels[OUT]; j++) {
                 if (filters[i].channels[OUT][j] == outputs[n]) {
                     outconvbuf_map[n][outconvbuf_n_filters[n]] = i;
-                    outconvbuf[n][outconvbuf_n_filters[n]] = ocbuf[i];
                     outscale[n][outconvbuf_n_filters[n]] = &icomm_fctrl[i].scale[OUT][j];
                     outconvbuf_n_filters[n]++;
                     /* output exists only once per filter, we can break here */
@@ -1358,6 +1942,11 @@ filter_process(struct filter_process_args *a)
         /* priority is lowered later if necessary */
         bf_make_realtime(bfconf->realtime_maxprio, "filter");
     }
+    if (bfconf->flush_denormals) {
+        /* denormals in decaying tails can make processing many times
+           slower, and are far below what any output can represent */
+        convolver_flush_denormals();
+    }
     bf_sem_post(output_writefd); /* for init */
 
     /* main filter loop starts here */
@@ -1373,6 +1962,10 @@ filter_process(struct filter_process_args *a)
         if (has_cb_input_devs) {
             bf_sem_wait(cb_input_readfd);
         }
+        if (dai_callback_direct()) {
+            stage_direct(&stage[IN], IN, procinputs, n_procinputs);
+            stage_direct(&stage[OUT], OUT, procoutputs, n_procoutputs);
+        }
         timestamp(&icomm->debug.f[dbg_pos].r_input.ts_ret);
         /* we only calculate period length if all filters are processing
            full length */
@@ -1412,13 +2005,53 @@ filter_process(struct filter_process_args *a)
                 icomm_fctrl[n].fscale[i] = icomm->fctrl[filters[n].intname].fscale[i];
             }
         }
+        if (output_timecbuf != NULL) {
+            for (n = 0; n < bfconf->n_filters; n++) {
+                icomm_coeff_all[n] = icomm->fctrl[bfconf->filters[n].intname].coeff;
+                icomm_delayblocks_all[n] = icomm->fctrl[bfconf->filters[n].intname].delayblocks;
+            }
+        }
         memcpy(icomm_ismuted, (void *)icomm->ismuted, sizeof(icomm_ismuted));
+        filter_liveness(live_all, icomm_ismuted[OUT]);
         memcpy(icomm_delay, (void *)icomm->delay, sizeof(icomm_delay));
         if (bfconf->use_subdelay[IN] || bfconf->use_subdelay[OUT]) {
             memcpy(icomm_subdelay, (void *)icomm->subdelay, sizeof(icomm_subdelay));
         }
+        /* subsample delays are folded into the coefficient sets as long as
+           they and the coefficient sets are unchanged */
+        sdfold_now = bfconf->use_sdfold && events.n_coeff_final == 0 &&
+            events.n_input_timed == 0 && events.n_output_timed == 0;
+        for (n = 0; n < bfconf->n_filters && sdfold_now; n++) {
+            if (bfconf->sdfold_coeff[n] != -1 &&
+                icomm->fctrl[n].coeff != bfconf->initfctrl[n].coeff)
+            {
+                sdfold_now = false;
+            }
+        }
+        FOR_IN_AND_OUT {
+            for (n = 0; n < bfconf->n_channels[IO] && sdfold_now; n++) {
+                if (bfconf->sdfold[IO][n] && icomm_subdelay[IO][n] != bfconf->subdelay[IO][n]) {
+                    sdfold_now = false;
+                }
+            }
+        }
         icomm_mutex(0);
 
+        if (sdfold && !sdfold_now) {
+            /* the channels filter their own subsample delays again */
+            for (n = 0; n < n_procinputs; n++) {
+                if (bfconf->sdfold[IN][procinputs[n]] && input_sd_rest[procinputs[n]] != NULL) {
+                    memset(input_sd_rest[procinputs[n]], 0, subdelay_fb_size * bfconf->realsize);
+                }
+            }
+            for (n = 0; n < n_procoutputs; n++) {
+                if (bfconf->sdfold[OUT][procoutputs[n]] && output_sd_rest[procoutputs[n]] != NULL) {
+                    memset(output_sd_rest[procoutputs[n]], 0, subdelay_fb_size * bfconf->realsize);
+                }
+            }
+        }
+        sdfold = sdfold_now;
+
         /* change to lower priority so we can be pre-empted, but we only do so
            if required by the input (or output) process */
         if (bfconf->realtime_priority && change_prio) {
@@ -1427,18 +2060,25 @@ filter_process(struct filter_process_args *a)
         timestamp(&icomm->debug.f[dbg_pos].mutex.ts_ret);
 
         timestamp(&t3);
+        if (stage[IN].n_channels > 0) {
+            timestamp(&t1);
+            stage_transpose(&stage[IN], IN, inbuf[curbuf]);
+            timestamp(&t2);
+            t[0] += t2 - t1;
+        }
         for (n = 0; n < n_procinputs; n++) {
             /* convert inputs */
             timestamp(&t1);
             virtch = procinputs[n];
             physch = bfconf->virt2phys[IN][virtch];
-            bf = &dai_buffer_format[IN]->bf[physch];
+            bf = stage_bf(&stage[IN], IN, physch);
+            ibuf = stage_buf(&stage[IN], physch, inbuf[curbuf]);
             sd_params.subdelay = icomm_subdelay[IN][virtch];
-            sd_params.rest = input_sd_rest[virtch];
+            sd_params.rest = sdfold && bfconf->sdfold[IN][virtch] ? NULL : input_sd_rest[virtch];
             if (bfconf->n_virtperphys[IN][physch] == 1) {
-                convolver_raw2cbuf(inbuf[curbuf],
-                                   input_timecbuf[n][curbuf],
-                                   input_timecbuf[n][!curbuf],
+                convolver_raw2cbuf(ibuf,
+                                   input_timecbuf[procinputs[n]][curbuf],
+                                   input_timecbuf[procinputs[n]][!curbuf],
                                    bf,
                                    apply_subdelay,
                                    (void *)&sd_params);
@@ -1449,7 +2089,7 @@ filter_process(struct filter_process_args *a)
                         delay += bfconf->sdf_length;
                     }
                     delay_update(input_db[virtch],
-                                 &((uint8_t *)inbuf[curbuf])[bf->byte_offset],
+                                 &((uint8_t *)ibuf)[bf->byte_offset],
                                  bf->sf.bytes, bf->sample_spacing,
                                  delay,
                                  inbuf_copy);
@@ -1458,27 +2098,53 @@ filter_process(struct filter_process_args *a)
                 }
                 inbuf_copy_bf.sf = bf->sf;
                 convolver_raw2cbuf(inbuf_copy,
-                                   input_timecbuf[n][curbuf],
-                                   input_timecbuf[n][!curbuf],
+                                   input_timecbuf[procinputs[n]][curbuf],
+                                   input_timecbuf[procinputs[n]][!curbuf],
                                    &inbuf_copy_bf,
                                    apply_subdelay,
                                    (void *)&sd_params);
             }
             for (i = 0; i < events.n_input_timed; i++) {
-                events.input_timed[i](input_timecbuf[n][curbuf], procinputs[n]);
+                events.input_timed[i](input_timecbuf[procinputs[n]][curbuf], procinputs[n]);
             }
             timestamp(&t2);
             t[0] += t2 - t1;
 
-            /* transform to frequency domain */
+            /* transform to frequency domain, unless all filters using the
+               input are run in the time-domain or cannot be heard */
             timestamp(&t1);
-            if (!powersave ||
-                !test_silent(input_timecbuf[n][curbuf], convbufsize,
+            fft_needed = events.n_input_freqd > 0;
+            for (i = 0; i < n_input_users[n] && !fft_needed; i++) {
+                j = input_users[n][i];
+                if (!own_filter[j]) {
+                    /* other filter processes read the filter control and
+                       mutes at another time, so whether their filters are
+                       heard and their mode is not known here */
+                    fft_needed = true;
+                    continue;
+                }
+                if (!live_all[j]) {
+                    continue;
+                }
+                if (output_timecbuf == NULL || events.n_coeff_final != 0 ||
+                    (bfconf->filters[j].partition == 0 &&
+                     !filter_td_mode(td_capable_all[j],
+                                     sdfold && bfconf->sdfold_coeff[j] != -1 ?
+                                     bfconf->sdfold_coeff[j] : icomm_coeff_all[j],
+                                     icomm_delayblocks_all[j])))
+                {
+                    fft_needed = true;
+                }
+            }
+            if (!fft_needed) {
+                /* nothing to do */
+            } else if (!powersave ||
+                !test_silent(input_timecbuf[procinputs[n]][curbuf], convbufsize,
                              bfconf->realsize,
                              bfconf->analog_powersave,
                              bf->sf.scale))
             {
-                convolver_time2freq(input_timecbuf[n][curbuf], input_freqcbuf[procinputs[n]]);
+                convolver_time2freq(input_timecbuf[procinputs[n]][curbuf], input_freqcbuf[procinputs[n]]);
                 input_freqcbuf_zero[procinputs[n]] = false;
             } else if (!input_freqcbuf_zero[procinputs[n]]) {
                 memset(input_freqcbuf[procinputs[n]], 0, convbufsize);
@@ -1495,41 +2161,208 @@ filter_process(struct filter_process_args *a)
         synch_filter_processes(filter_readfd, filter_writefd, process_index);
         timestamp(&icomm->debug.f[dbg_pos].fsynch_fd.ts_ret);
 
+        /* filter chains with the same coefficients and delays as when they
+           were fused at configuration time are run as one filter */
+        memset(fuse_skip, 0, n_filters * sizeof(bool));
+        for (n = 0; n < n_filters; n++) {
+            if ((i = fuse_local[n]) == -1) {
+                continue;
+            }
+            j = filters[n].intname;
+            fused = events.n_coeff_final == 0 &&
+                events.n_pre_convolve == 0 &&
+                events.n_post_convolve == 0 &&
+                icomm_fctrl[i].coeff == bfconf->fuse_src_coeff[j] &&
+                icomm_fctrl[n].coeff == bfconf->fuse_own_coeff[j] &&
+                icomm_fctrl[i].delayblocks <= 0 &&
+                icomm_fctrl[n].delayblocks <= 0 &&
+                live_all[filters[i].intname];
+            if (fused != fusemode[n]) {
+                /* block history restarts when changing mode */
+                procblocks[n] = procblocks[i] = 0;
+                if (!fused) {
+                    memset(evalbuf[n], 0, convbufsize + convbufsize / 2);
+                    evalbuf_zero[n] = true;
+                }
+            }
+            fusemode[n] = fused;
+            fuse_skip[i] = fused;
+        }
+
+        /* filters which still compute the same as an earlier filter use the
+           output of that filter instead of their own */
+        for (n = 0; n < n_filters; n++) {
+            if ((i = cse_local[n]) == -1) {
+                continue;
+            }
+            csemode[n] = events.n_coeff_final == 0 &&
+                events.n_pre_convolve == 0 &&
+                events.n_post_convolve == 0 &&
+                icomm_fctrl[n].coeff == icomm_fctrl[i].coeff &&
+                icomm_fctrl[n].delayblocks == icomm_fctrl[i].delayblocks &&
+                live_all[filters[i].intname];
+            for (j = 0; j < filters[n].n_channels[IN] && csemode[n]; j++) {
+                if (icomm_fctrl[n].scale[IN][j] != icomm_fctrl[i].scale[IN][j]) {
+                    csemode[n] = false;
+                }
+            }
+        }
+
         for (n = 0; n < n_filters; n++) {
             if (procblocks[n] < n_blocks) {
                 procblocks[n]++;
             } else {
                 bit32_clr(partial_proc, n);
             }
+            if (fuse_skip[n]) {
+                /* fused into the filter it outputs to */
+                continue;
+            }
+            if (!live_all[filters[n].intname] && gain_db[n] == NULL) {
+                /* the output cannot be heard, so the filter is not run and
+                   its history restarts when it can be heard again */
+                procblocks[n] = 0;
+                bit32_set(partial_proc, n);
+                tdmode[n] = false;
+                xfading[n] = false;
+                prevcoeff[n] = icomm_fctrl[n].coeff;
+                if (!ocbuf_zero[n]) {
+                    memset(ocbuf[n], 0, convbufsize);
+                    ocbuf_zero[n] = true;
+                    if (n_blocks == 1) {
+                        cbuf_zero[n][0] = true;
+                    }
+                }
+                continue;
+            }
             timestamp(&t1);
             coeff = icomm_fctrl[n].coeff;
             if (events.n_coeff_final == 1) {
                 /* this module wants final control of the choice of coefficient */
                 events.coeff_final[0](filters[n].intname, &coeff);
             }
+            if (fusemode[n]) {
+                coeff = bfconf->fuse_coeff[filters[n].intname];
+            }
+            if (sdfold && bfconf->sdfold_coeff[filters[n].intname] != -1) {
+                coeff = bfconf->sdfold_coeff[filters[n].intname];
+            }
             delay = icomm_fctrl[n].delayblocks;
             if (delay < 0) {
                 delay = 0;
-            } else if (delay > n_blocks - 1) {
-                delay = n_blocks - 1;
-            }
-            if (coeff < 0 ||
-                bfconf->coeffs[coeff].n_blocks > n_blocks - delay)
-            {
-                cblocks = n_blocks - delay;
+            } else if (delay > n_ring[n] - 1) {
+                delay = n_ring[n] - 1;
+            }
+            /* the coefficients are only truncated if the delay is larger
+               than the extra blocks in the ring */
+            i = n_ring[n] - delay < n_blocks ? n_ring[n] - delay : n_blocks;
+            if (coeff < 0 || bfconf->coeffs[coeff].n_blocks > i) {
+                cblocks = i;
             } else {
                 cblocks = bfconf->coeffs[coeff].n_blocks;
             }
-            if (prevcoeff[n] < 0 || bfconf->coeffs[prevcoeff[n]].n_blocks > n_blocks - delay) {
-                prevcblocks = n_blocks - delay;
+            if (prevcoeff[n] < 0 || bfconf->coeffs[prevcoeff[n]].n_blocks > i) {
+                prevcblocks = i;
             } else {
                 prevcblocks = bfconf->coeffs[prevcoeff[n]].n_blocks;
             }
+            /* when the delay grows, the blocks skipped over were last
+               written a full ring ago and must be cleared */
+            for (i = prevdelay[n]; i < delay; i++) {
+                j = (int)((blockcounter + i) % (unsigned int)n_ring[n]);
+                if (!cbuf_zero[n][j]) {
+                    memset(cbuf[n][j], 0, convbufsize);
+                    cbuf_zero[n][j] = true;
+                }
+            }
+            prevdelay[n] = delay;
 
-            curblock = (int)((blockcounter + delay) % (unsigned int)(n_blocks));
+            curblock = (int)((blockcounter + delay) % (unsigned int)n_ring[n]);
 
+            if (pstate[n] != NULL) {
+                /* longer partition than the filter length, runs on its own
+                   and outputs in the time-domain */
+                for (i = 0; i < filters[n].n_channels[IN]; i++) {
+                    scales[i] = icomm_fctrl[n].scale[IN][i] * virtscales[IN][filters[n].channels[IN][i]];
+                    tdinbufs[i] = &((uint8_t *)input_timecbuf[filters[n].channels[IN][i]][curbuf])
+                        [fragsize * bfconf->realsize];
+                }
+                part_process(pstate[n], tdinbufs, scales, filters[n].n_channels[IN],
+                             coeff, blockcounter, tdbuf[n]);
+                tdmode[n] = true;
+                prevcoeff[n] = coeff;
+                timestamp(&t2);
+                t[3] += t2 - t1;
+                continue;
+            }
+            tdmode[n] = filter_td_mode(td_capable[n], coeff, delay);
+            if (tdmode[n] && (coeff < 0 || bfconf->coeffs_dirac_pos[coeff] >= 0)) {
+                /* the coefficient set is a scaled and delayed dirac pulse, so
+                   it is just a matter of mixing the inputs with some offset,
+                   or via a delay buffer if the delay is longer than a block */
+                if (coeff < 0) {
+                    gain = 1.0;
+                    j = 0;
+                } else {
+                    gain = bfconf->coeffs_dirac_gain[coeff];
+                    j = bfconf->coeffs_dirac_pos[coeff];
+                }
+                for (i = 0; i < filters[n].n_channels[IN]; i++) {
+                    scales[i] = gain * icomm_fctrl[n].scale[IN][i] * virtscales[IN][filters[n].channels[IN][i]];
+                    tdinbufs[i] = &((uint8_t *)input_timecbuf[filters[n].channels[IN][i]][curbuf])
+                        [(j <= fragsize ? fragsize - j : fragsize) * bfconf->realsize];
+                }
+                convolver_td_mixnscale(tdinbufs, tdbuf[n], scales, filters[n].n_channels[IN], fragsize);
+                if (gain_db[n] != NULL) {
+                    delay_update(gain_db[n], tdbuf[n], bfconf->realsize, 1, j <= fragsize ? 0 : j, NULL);
+                }
+                procblocks[n] = 0;
+                bit32_clr(partial_proc, n);
+                prevcoeff[n] = coeff;
+                timestamp(&t2);
+                t[3] += t2 - t1;
+                continue;
+            }
+            if (tdmode[n]) {
+                /* short coefficient set, so we do direct form FIR filtering in
+                   the time-domain instead. Block history is not updated, so
+                   it restarts if changing back to a long coefficient set. */
+                taps = bfconf->coeffs_td[coeff];
+                n_taps = bfconf->coeffs_td_len[coeff];
+                for (i = 0; i < filters[n].n_channels[IN]; i++) {
+                    scales[i] = icomm_fctrl[n].scale[IN][i] * virtscales[IN][filters[n].channels[IN][i]];
+                }
+                if (filters[n].n_channels[IN] == 1) {
+                    convolver_td_fir(input_timecbuf[filters[n].channels[IN][0]][curbuf],
+                                     taps, n_taps, scales[0], tdbuf[n]);
+                } else {
+                    /* mix the inputs and the history required by the filter
+                       into the otherwise unused output buffer */
+                    j = (n_taps + 3) & ~3;
+                    for (i = 0; i < filters[n].n_channels[IN]; i++) {
+                        tdinbufs[i] = &((uint8_t *)input_timecbuf[filters[n].channels[IN][i]][curbuf])
+                            [(fragsize - j) * bfconf->realsize];
+                    }
+                    convolver_td_mixnscale(tdinbufs,
+                                           &((uint8_t *)ocbuf[n])[(fragsize - j) * bfconf->realsize],
+                                           scales,
+                                           filters[n].n_channels[IN],
+                                           fragsize + j);
+                    convolver_td_fir(ocbuf[n], taps, n_taps, 1.0, tdbuf[n]);
+                    ocbuf_zero[n] = false;
+                    if (n_blocks == 1) {
+                        cbuf_zero[n][0] = false;
+                    }
+                }
+                procblocks[n] = 0;
+                bit32_clr(partial_proc, n);
+                prevcoeff[n] = coeff;
+                timestamp(&t2);
+                t[3] += t2 - t1;
+                continue;
+            }
             /* mix and scale inputs prior to convolution */
-            if (filters[n].n_filters[IN] > 0) {
+            if (filters[n].n_filters[IN] > 0 && !fusemode[n]) {
                 /* mix, scale and reorder filter-inputs for evaluation in the time domain. */
                 iszero = true;
                 for (i = 0; i < filters[n].n_filters[IN]; i++) {
@@ -1586,18 +2419,23 @@ filter_process(struct filter_process_args *a)
                     cbuf_zero[n][curblock] = true;
                 }
             } else {
+                /* when fused, the inputs of the source filter are used */
+                j = fusemode[n] ? fuse_local[n] : n;
                 iszero = true;
-                for (i = 0; i < filters[n].n_channels[IN]; i++) {
-                    scales[i] = icomm_fctrl[n].scale[IN][i] * virtscales[IN][filters[n].channels[IN][i]];
-                    if (!input_freqcbuf_zero[filters[n].channels[IN][i]]) {
+                for (i = 0; i < filters[j].n_channels[IN]; i++) {
+                    scales[i] = icomm_fctrl[j].scale[IN][i] * virtscales[IN][filters[j].channels[IN][i]];
+                    if (fusemode[n]) {
+                        scales[i] *= icomm_fctrl[n].fscale[0];
+                    }
+                    if (!input_freqcbuf_zero[filters[j].channels[IN][i]]) {
                         iszero = false;
                     }
                 }
                 if (!iszero || !powersave) {
-                    convolver_mixnscale(mixconvbuf_inputs[n],
+                    convolver_mixnscale(mixconvbuf_inputs[j],
                                         cbuf[n][curblock],
                                         scales,
-                                        filters[n].n_channels[IN],
+                                        filters[j].n_channels[IN],
                                         CONVOLVER_MIXMODE_INPUT);
                     cbuf_zero[n][curblock] = false;
                 } else if (!cbuf_zero[n][curblock]) {
@@ -1610,24 +2448,43 @@ filter_process(struct filter_process_args *a)
             /* convolve (or not) */
             timestamp(&t1);
 
-            curblock = (int)(blockcounter % (unsigned int)n_blocks);
+            if (csemode[n]) {
+                /* the input history is kept up to date above, so the filter
+                   can take over seamlessly when it is no longer the same */
+                prevcoeff[n] = coeff;
+                timestamp(&t2);
+                t[3] += t2 - t1;
+                continue;
+            }
+
+            curblock = (int)(blockcounter % (unsigned int)n_ring[n]);
             for (i = 0; i < events.n_pre_convolve; i++) {
                 events.pre_convolve[i](cbuf[n][curblock], n);
             }
+            xfading[n] = false;
+            if (filters[n].crossfade && prevcoeff[n] != coeff) {
+                /* output of the previous coefficient set goes to a filter
+                   buffer if it can be crossfaded in the time-domain later,
+                   otherwise it is crossfaded here */
+                xfbuf = xfadebuf[n] != NULL ? xfadebuf[n] : crossfadebuf[0];
+            }
             if (coeff >= 0) {
                 if (n_blocks == 1) {
                     /* curblock is always zero when n_blocks == 1 */
                     if (!cbuf_zero[n][0] || !powersave) {
                         if (filters[n].crossfade && prevcoeff[n] != coeff) {
                             if (prevcoeff[n] < 0) {
-                                convolver_dirac_convolve(cbuf[n][0], crossfadebuf[0]);
+                                convolver_dirac_convolve(cbuf[n][0], xfbuf);
                             } else {
-                                convolver_convolve(cbuf[n][0], bfconf->coeffs_data[prevcoeff[n]][0],
-                                                   crossfadebuf[0]);
+                                convolver_convolve(cbuf[n][0], bfconf->coeffs_data[prevcoeff[n]][0], xfbuf);
                             }
                             convolver_convolve_inplace(cbuf[n][0], bfconf->coeffs_data[coeff][0]);
-                            convolver_crossfade_inplace(cbuf[n][0], crossfadebuf[0], crossfadebuf[1]);
-                            temp_buffer_zero = false;
+                            if (xfadebuf[n] != NULL) {
+                                xfading[n] = true;
+                            } else {
+                                convolver_crossfade_inplace(cbuf[n][0], crossfadebuf[0], crossfadebuf[1]);
+                                temp_buffer_zero = false;
+                            }
                         } else {
                             convolver_convolve_inplace(cbuf[n][0], bfconf->coeffs_data[coeff][0]);
                         }
@@ -1642,20 +2499,24 @@ filter_process(struct filter_process_args *a)
                     if (!cbuf_zero[n][curblock] || !powersave) {
                         if (filters[n].crossfade && prevcoeff[n] != coeff) {
                             if (prevcoeff[n] < 0) {
-                                convolver_dirac_convolve(cbuf[n][curblock], crossfadebuf[0]);
+                                convolver_dirac_convolve(cbuf[n][curblock], xfbuf);
                             } else {
-                                convolver_convolve(cbuf[n][curblock], bfconf->coeffs_data[prevcoeff[n]][0],
-                                                   crossfadebuf[0]);
+                                convolver_convolve(cbuf[n][curblock], bfconf->coeffs_data[prevcoeff[n]][0], xfbuf);
                             }
                         }
                         convolver_convolve(cbuf[n][curblock], bfconf->coeffs_data[coeff][0], ocbuf[n]);
                         ocbuf_zero[n] = false;
-                    } else if (!ocbuf_zero[n]) {
-                        memset(ocbuf[n], 0, convbufsize);
-                        ocbuf_zero[n] = true;
+                    } else {
+                        if (filters[n].crossfade && prevcoeff[n] != coeff) {
+                            memset(xfbuf, 0, convbufsize);
+                        }
+                        if (!ocbuf_zero[n]) {
+                            memset(ocbuf[n], 0, convbufsize);
+                            ocbuf_zero[n] = true;
+                        }
                     }
                     for (i = 1; i < cblocks && i < procblocks[n]; i++) {
-                        j = (int)((blockcounter - i) % (unsigned int)n_blocks);
+                        j = (int)((blockcounter - i) % (unsigned int)n_ring[n]);
                         if (!cbuf_zero[n][j] || !powersave) {
                             convolver_convolve_add(cbuf[n][j], bfconf->coeffs_data[coeff][i], ocbuf[n]);
                             ocbuf_zero[n] = false;
@@ -1663,10 +2524,9 @@ filter_process(struct filter_process_args *a)
                     }
                     if (filters[n].crossfade && prevcoeff[n] != coeff && prevcoeff[n] >= 0) {
                         for (i = 1; i < prevcblocks && i < procblocks[n]; i++) {
-                            j = (int)((blockcounter - i) % (unsigned int)n_blocks);
+                            j = (int)((blockcounter - i) % (unsigned int)n_ring[n]);
                             if (!cbuf_zero[n][j] || !powersave) {
-                                convolver_convolve_add(cbuf[n][j], bfconf->coeffs_data[prevcoeff[n]][i],
-                                                       crossfadebuf[0]);
+                                convolver_convolve_add(cbuf[n][j], bfconf->coeffs_data[prevcoeff[n]][i], xfbuf);
                             }
                             ocbuf_zero[n] = false;
                         }
@@ -1675,19 +2535,26 @@ filter_process(struct filter_process_args *a)
                         procblocks[n] = 0;
                         bit32_set(partial_proc, n);
                     } else if (filters[n].crossfade && prevcoeff[n] != coeff) {
-                        convolver_crossfade_inplace(ocbuf[n], crossfadebuf[0], crossfadebuf[1]);
-                        temp_buffer_zero = false;
+                        if (xfadebuf[n] != NULL) {
+                            xfading[n] = true;
+                        } else {
+                            convolver_crossfade_inplace(ocbuf[n], crossfadebuf[0], crossfadebuf[1]);
+                            temp_buffer_zero = false;
+                        }
                     }
                 }
             } else {
                 if (n_blocks == 1) {
                     if (!cbuf_zero[n][0] || !powersave) {
                         if (filters[n].crossfade && prevcoeff[n] != coeff) {
-                            convolver_convolve(cbuf[n][0], bfconf->coeffs_data[prevcoeff[n]][0],
-                                               crossfadebuf[0]);
+                            convolver_convolve(cbuf[n][0], bfconf->coeffs_data[prevcoeff[n]][0], xfbuf);
                             convolver_dirac_convolve_inplace(cbuf[n][0]);
-                            convolver_crossfade_inplace(cbuf[n][0], crossfadebuf[0], crossfadebuf[1]);
-                            temp_buffer_zero = false;
+                            if (xfadebuf[n] != NULL) {
+                                xfading[n] = true;
+                            } else {
+                                convolver_crossfade_inplace(cbuf[n][0], crossfadebuf[0], crossfadebuf[1]);
+                                temp_buffer_zero = false;
+                            }
                         } else {
                             convolver_dirac_convolve_inplace(cbuf[n][0]);
                         }
@@ -1700,21 +2567,24 @@ filter_process(struct filter_process_args *a)
                 } else {
                     if (!cbuf_zero[n][curblock] || !powersave) {
                         if (filters[n].crossfade && prevcoeff[n] != coeff) {
-                            convolver_convolve(cbuf[n][curblock], bfconf->coeffs_data[prevcoeff[n]][0],
-                                               crossfadebuf[0]);
+                            convolver_convolve(cbuf[n][curblock], bfconf->coeffs_data[prevcoeff[n]][0], xfbuf);
                         }
                         convolver_dirac_convolve(cbuf[n][curblock], ocbuf[n]);
                         ocbuf_zero[n] = false;
-                    } else if (!ocbuf_zero[n]) {
-                        memset(ocbuf[n], 0, convbufsize);
-                        ocbuf_zero[n] = true;
+                    } else {
+                        if (filters[n].crossfade && prevcoeff[n] != coeff) {
+                            memset(xfbuf, 0, convbufsize);
+                        }
+                        if (!ocbuf_zero[n]) {
+                            memset(ocbuf[n], 0, convbufsize);
+                            ocbuf_zero[n] = true;
+                        }
                     }
                     if (filters[n].crossfade && prevcoeff[n] != coeff) {
                         for (i = 1; i < prevcblocks && i < procblocks[n]; i++) {
-                            j = (int)((blockcounter - i) % (unsigned int)n_blocks);
+                            j = (int)((blockcounter - i) % (unsigned int)n_ring[n]);
                             if (!cbuf_zero[n][j] || !powersave) {
-                                convolver_convolve_add(cbuf[n][j], bfconf->coeffs_data[prevcoeff[n]][i],
-                                                       crossfadebuf[0]);
+                                convolver_convolve_add(cbuf[n][j], bfconf->coeffs_data[prevcoeff[n]][i], xfbuf);
                             }
                             ocbuf_zero[n] = false;
                         }
@@ -1723,8 +2593,12 @@ filter_process(struct filter_process_args *a)
                         procblocks[n] = 0;
                         bit32_set(partial_proc, n);
                     } else if (filters[n].crossfade && prevcoeff[n] != coeff) {
-                        convolver_crossfade_inplace(ocbuf[n], crossfadebuf[0], crossfadebuf[1]);
-                        temp_buffer_zero = false;
+                        if (xfadebuf[n] != NULL) {
+                            xfading[n] = true;
+                        } else {
+                            convolver_crossfade_inplace(ocbuf[n], crossfadebuf[0], crossfadebuf[1]);
+                            temp_buffer_zero = false;
+                        }
                     }
                 }
             }
@@ -1738,26 +2612,74 @@ filter_process(struct filter_process_args *a)
 
         timestamp(&t1);
         for (n = 0; n < n_outputs; n++) {
+            /* sort out filters run in the time-domain, and if any of the
+               others crossfades, a mix using the previous coefficient set
+               output of those is needed as well, the crossfade is then done
+               after transform to time domain */
             iszero = true;
+            xfade = false;
+            n_td = n_fd = 0;
             for (i = 0; i < outconvbuf_n_filters[n]; i++) {
-                scales[i] = *outscale[n][i] / virtscales[OUT][outputs[n]];
-                if (!ocbuf_zero[outconvbuf_map[n][i]]) {
+                j = outconvbuf_map[n][i];
+                if (!live_all[filters[j].intname]) {
+                    continue;
+                }
+                if (tdmode[j]) {
+                    tdconvbuf[n_td] = tdbuf[j];
+                    tdscales[n_td++] = *outscale[n][i] / virtscales[OUT][outputs[n]];
+                    continue;
+                }
+                if (csemode[j]) {
+                    j = cse_local[j];
+                }
+                fdconvbuf[n_fd] = ocbuf[j];
+                if (xfading[j]) {
+                    xfconvbuf[n_fd] = xfadebuf[j];
+                    xfade = true;
+                } else {
+                    xfconvbuf[n_fd] = ocbuf[j];
+                }
+                scales[n_fd++] = *outscale[n][i] / virtscales[OUT][outputs[n]];
+                if (!ocbuf_zero[j]) {
                     iszero = false;
                 }
             }
             /* mix and scale convolve outputs prior to conversion to time
                domain */
-            if (!iszero || !powersave) {
-                convolver_mixnscale(outconvbuf[n],
+            if (n_fd == 0 && output_timecbuf != NULL) {
+                /* nothing to do */
+            } else if (n_fd > 0 && (!iszero || !powersave)) {
+                convolver_mixnscale(fdconvbuf,
                                     output_freqcbuf[outputs[n]],
                                     scales,
-                                    outconvbuf_n_filters[n],
+                                    n_fd,
                                     CONVOLVER_MIXMODE_OUTPUT);
                 output_freqcbuf_zero[outputs[n]] = false;
             } else if (!output_freqcbuf_zero[outputs[n]]) {
                 memset(output_freqcbuf[outputs[n]], 0, convbufsize);
                 output_freqcbuf_zero[outputs[n]] = true;
             }
+            if (output_xfadecbuf != NULL) {
+                if (xfade) {
+                    convolver_mixnscale(xfconvbuf,
+                                        output_xfadecbuf[outputs[n]],
+                                        scales,
+                                        n_fd,
+                                        CONVOLVER_MIXMODE_OUTPUT);
+                }
+                icomm->output_xfade[outputs[n]] = xfade;
+            }
+            if (output_timecbuf != NULL) {
+                if (n_td > 0) {
+                    convolver_td_mixnscale(tdconvbuf,
+                                           output_timecbuf[outputs[n]],
+                                           tdscales,
+                                           n_td,
+                                           fragsize);
+                }
+                icomm->output_fd[outputs[n]] = n_fd > 0;
+                icomm->output_td[outputs[n]] = n_td > 0;
+            }
         }
         timestamp(&t2);
         t[4] += t2 - t1;
@@ -1772,32 +2694,143 @@ filter_process(struct filter_process_args *a)
             timestamp(&t1);
             virtch = procoutputs[n];
             physch = bfconf->virt2phys[OUT][virtch];
+            n_virt = bfconf->n_virtperphys[OUT][physch];
+            fdmix = j == 0 && n_virt > 1 &&
+                events.n_output_freqd == 0 && events.n_output_timed == 0;
+            for (i = 0; i < n_virt && fdmix; i++) {
+                k = procoutputs[n + i];
+                if ((output_sd_rest[k] != NULL && !(sdfold && bfconf->sdfold[OUT][k])) ||
+                    icomm_delay[OUT][k] != 0 ||
+                    (bfconf->use_subdelay[OUT] &&
+                     bfconf->subdelay[OUT][k] == BF_UNDEFINED_SUBDELAY) ||
+                    (output_xfadecbuf != NULL && icomm->output_xfade[k]))
+                {
+                    fdmix = false;
+                }
+            }
+            if (fdmix) {
+                /* none of the virtual channels mixed to this physical one is
+                   delayed, so their spectra can be summed and transformed
+                   once */
+                n_fd = n_td = 0;
+                for (i = 0; i < n_virt; i++) {
+                    k = procoutputs[n + i];
+                    /* keeps the delay buffer in sync for later delay changes */
+                    delay_update(output_db[k], ocbuf[0], bfconf->realsize, 1, 0, NULL);
+                    if (bit32_isset(icomm_ismuted[OUT], k)) {
+                        continue;
+                    }
+                    if ((output_timecbuf == NULL || icomm->output_fd[k]) &&
+                        (!output_freqcbuf_zero[k] || !powersave))
+                    {
+                        virtmixbufs[n_fd] = output_freqcbuf[k];
+                        virtmixscales[n_fd++] = 1.0;
+                    }
+                    if (output_timecbuf != NULL && icomm->output_td[k]) {
+                        n_td++;
+                    }
+                }
+                if (n_fd > 0) {
+                    convolver_td_mixnscale(virtmixbufs, ocbuf[0], virtmixscales, n_fd,
+                                           convbufsize / bfconf->realsize);
+                    convolver_freq2time(ocbuf[0], ocbuf[0]);
+                }
+                if (n_td > 0) {
+                    n_td = 0;
+                    if (n_fd > 0) {
+                        virtmixbufs[n_td++] = ocbuf[0];
+                    }
+                    for (i = 0; i < n_virt; i++) {
+                        k = procoutputs[n + i];
+                        if (!bit32_isset(icomm_ismuted[OUT], k) && icomm->output_td[k]) {
+                            virtmixbufs[n_td] = output_timecbuf[k];
+                            virtmixscales[n_td++] = 1.0;
+                        }
+                    }
+                    convolver_td_mixnscale(virtmixbufs, ocbuf[0], virtmixscales, n_td, fragsize);
+                }
+                if (n_fd > 0 || n_td > 0) {
+                    ocbuf_zero[0] = false;
+                    if (n_blocks == 1) {
+                        cbuf_zero[0][0] = false;
+                    }
+                } else if (!ocbuf_zero[0]) {
+                    memset(ocbuf[0], 0, convbufsize);
+                    ocbuf_zero[0] = true;
+                    if (n_blocks == 1) {
+                        cbuf_zero[0][0] = true;
+                    }
+                }
+                timestamp(&t2);
+                t[5] += t2 - t1;
+
+                timestamp(&t1);
+                of = icomm->overflow[virtch];
+                convolver_cbuf2raw(ocbuf[0],
+                                   stage_buf(&stage[OUT], physch, outbuf[curbuf]),
+                                   stage_bf(&stage[OUT], OUT, physch),
+                                   bfconf->dither_state[physch] != NULL,
+                                   bfconf->dither_state[physch],
+                                   &of);
+                for (i = 0; i < n_virt; i++) {
+                    icomm->overflow[bfconf->phys2virt[OUT][physch][i]] = of;
+                }
+                n += n_virt - 1;
+                timestamp(&t2);
+                t[6] += t2 - t1;
+                continue;
+            }
             for (i = 0; i < events.n_output_freqd; i++) {
                 events.output_freqd[i](output_freqcbuf[virtch], virtch);
             }
             /* ocbuf[0] happens to be free, that's why we use it */
-            if (!output_freqcbuf_zero[virtch] || !powersave) {
-                convolver_freq2time(output_freqcbuf[virtch], ocbuf[0]);
-                ocbuf_zero[0] = false;
-                if (n_blocks == 1) {
-                    cbuf_zero[0][0] = false;
+            if (output_timecbuf != NULL && !icomm->output_fd[virtch]) {
+                /* only filters run in the time-domain, or none, mix to this
+                   output, so there is nothing to transform */
+                if (icomm->output_td[virtch]) {
+                    memcpy(ocbuf[0], output_timecbuf[virtch], fragsize * bfconf->realsize);
+                    ocbuf_zero[0] = false;
+                    if (n_blocks == 1) {
+                        cbuf_zero[0][0] = false;
+                    }
+                } else if (!ocbuf_zero[0]) {
+                    memset(ocbuf[0], 0, convbufsize);
+                    ocbuf_zero[0] = true;
+                    if (n_blocks == 1) {
+                        cbuf_zero[0][0] = true;
+                    }
                 }
-            } else if (!ocbuf_zero[0]) {
-                memset(ocbuf[0], 0, convbufsize);
-                ocbuf_zero[0] = true;
-                if (n_blocks == 1) {
-                    cbuf_zero[0][0] = true;
+            } else {
+                if (!output_freqcbuf_zero[virtch] || !powersave) {
+                    convolver_freq2time(output_freqcbuf[virtch], ocbuf[0]);
+                    ocbuf_zero[0] = false;
+                    if (n_blocks == 1) {
+                        cbuf_zero[0][0] = false;
+                    }
+                } else if (!ocbuf_zero[0]) {
+                    memset(ocbuf[0], 0, convbufsize);
+                    ocbuf_zero[0] = true;
+                    if (n_blocks == 1) {
+                        cbuf_zero[0][0] = true;
+                    }
+                }
+                if (output_xfadecbuf != NULL && icomm->output_xfade[virtch]) {
+                    convolver_freq2time(output_xfadecbuf[virtch], crossfadebuf[1]);
+                    convolver_crossfade_time(crossfadebuf[1], ocbuf[0]);
+                    ocbuf_zero[0] = false;
+                    if (n_blocks == 1) {
+                        cbuf_zero[0][0] = false;
+                    }
+                }
+                if (output_timecbuf != NULL && icomm->output_td[virtch]) {
+                    tdaddbufs[0] = ocbuf[0];
+                    tdaddbufs[1] = output_timecbuf[virtch];
+                    convolver_td_mixnscale(tdaddbufs, ocbuf[0], tdaddscales, 2, fragsize);
+                    ocbuf_zero[0] = false;
+                    if (n_blocks == 1) {
+                        cbuf_zero[0][0] = false;
+                    }
                 }
-            }
-
-            /* Check if there is NaN or Inf values, and abort if so. We cannot
-               afford to check all values, but NaN/Inf tend to spread, so
-               checking only one value usually catches the problem. */
-            if ((bfconf->realsize == sizeof(float) && !isfinite((double)((float *)ocbuf[0])[0])) ||
-                (bfconf->realsize == sizeof(double) && !isfinite(((double *)ocbuf[0])[0])))
-            {
-                fprintf(stderr, "NaN or Inf values in the system! Invalid input? Aborting.\n");
-                bf_exit(BF_EXIT_OTHER);
             }
 
             timestamp(&t2);
@@ -1808,7 +2841,7 @@ filter_process(struct filter_process_args *a)
             for (i = 0; i < events.n_output_timed; i++) {
                 events.output_timed[i](ocbuf[0], virtch);
             }
-            if (output_sd_rest[virtch] != NULL) {
+            if (output_sd_rest[virtch] != NULL && !(sdfold && bfconf->sdfold[OUT][virtch])) {
                 delay_subsample_update(ocbuf[0], output_sd_rest[virtch], icomm_subdelay[OUT][virtch]);
             }
             if (bfconf->n_virtperphys[OUT][physch] == 1) {
@@ -1816,8 +2849,8 @@ filter_process(struct filter_process_args *a)
                    we write to it directly */
                 of = icomm->overflow[virtch];
                 convolver_cbuf2raw(ocbuf[0],
-                                   outbuf[curbuf],
-                                   &dai_buffer_format[OUT]->bf[physch],
+                                   stage_buf(&stage[OUT], physch, outbuf[curbuf]),
+                                   stage_bf(&stage[OUT], OUT, physch),
                                    bfconf->dither_state[physch] != NULL,
                                    bfconf->dither_state[physch],
                                    &of);
@@ -1836,21 +2869,9 @@ filter_process(struct filter_process_args *a)
                     if (!mixbuf_is_filled) {
                         memcpy(mixbuf, ocbuf[0], fragsize * bfconf->realsize);
                     } else {
-                        if (bfconf->realsize == 4) {
-                            for (i = 0; i < fragsize; i += 4) {
-                                ((float *)mixbuf)[i+0] += ((float *)ocbuf[0])[i+0];
-                                ((float *)mixbuf)[i+1] += ((float *)ocbuf[0])[i+1];
-                                ((float *)mixbuf)[i+2] += ((float *)ocbuf[0])[i+2];
-                                ((float *)mixbuf)[i+3] += ((float *)ocbuf[0])[i+3];
-                            }
-                        } else {
-                            for (i = 0; i < fragsize; i += 4) {
-                                ((double *)mixbuf)[i+0] += ((double *)ocbuf[0])[i+0];
-                                ((double *)mixbuf)[i+1] += ((double *)ocbuf[0])[i+1];
-                                ((double *)mixbuf)[i+2] += ((double *)ocbuf[0])[i+2];
-                                ((double *)mixbuf)[i+3] += ((double *)ocbuf[0])[i+3];
-                            }
-                        }
+                        tdaddbufs[0] = mixbuf;
+                        tdaddbufs[1] = ocbuf[0];
+                        convolver_td_mixnscale(tdaddbufs, mixbuf, tdaddscales, 2, fragsize);
                     }
                     temp_buffer_zero = false;
                     mixbuf_is_filled = true;
@@ -1868,8 +2889,8 @@ filter_process(struct filter_process_args *a)
                        assigned to a single physical one, so we copy them */
                     of = icomm->overflow[virtch];
                     convolver_cbuf2raw(mixbuf,
-                                       outbuf[curbuf],
-                                       &dai_buffer_format[OUT]->bf[physch],
+                                       stage_buf(&stage[OUT], physch, outbuf[curbuf]),
+                                       stage_bf(&stage[OUT], OUT, physch),
                                        bfconf->dither_state[physch] != NULL,
                                        bfconf->dither_state[physch],
                                        &of);
@@ -1881,6 +2902,12 @@ filter_process(struct filter_process_args *a)
             timestamp(&t2);
             t[6] += t2 - t1;
         }
+        if (stage[OUT].n_channels > 0) {
+            timestamp(&t1);
+            stage_transpose(&stage[OUT], OUT, outbuf[curbuf]);
+            timestamp(&t2);
+            t[6] += t2 - t1;
+        }
         timestamp(&t4);
         t[7] += t4 - t3;
 
@@ -2118,6 +3145,11 @@ bfrun(void)
 
     void *input_freqcbuf[bfconf->n_channels[IN]], *input_freqcbuf_base;
     void *output_freqcbuf[bfconf->n_channels[OUT]], *output_freqcbuf_base;
+    void *output_xfadecbuf[bfconf->n_channels[OUT]], *output_xfadecbuf_base;
+    void *input_timecbuf[bfconf->n_channels[IN]][2], *input_timecbuf_base;
+    void *output_timecbuf[bfconf->n_channels[OUT]], *output_timecbuf_base;
+    bool need_xfadecbuf = false;
+    bool need_timecbuf = bfconf->direct_fir_taps > 0;
 
     glob.n_callback_devs[IN] = 0;
     glob.n_callback_devs[OUT] = 0;
@@ -2135,7 +3167,27 @@ bfrun(void)
 
     /* allocate shared memory for I/O buffers and interprocess communication */
     const int cbufsize = convolver_cbufsize();
+    /* The time-domain input of a channel is the FFT input, the previous block
+       followed by the new one. With a mirrored ring of two blocks the two
+       views overlap such that the new block is converted straight into
+       place, and is already the previous block of the other view next
+       period, so it need not be copied. Otherwise two separate buffers are
+       used. The mirror is a shared mapping, so it works with fork too. */
+    int n_unmirrored = 0;
+    for (int n = 0; n < bfconf->n_channels[IN]; n++) {
+        uint8_t *ring = allocate_mirrored_memory(cbufsize);
+        if (ring == NULL) {
+            input_timecbuf[n][0] = NULL;
+            n_unmirrored++;
+            continue;
+        }
+        input_timecbuf[n][0] = ring;
+        input_timecbuf[n][1] = ring + cbufsize / 2;
+    }
+    input_timecbuf_base = NULL;
     if ((input_freqcbuf_base = maybe_shmalloc(bfconf->n_channels[IN] * cbufsize)) == NULL ||
+        (n_unmirrored > 0 &&
+         (input_timecbuf_base = maybe_shmalloc(n_unmirrored * 2 * cbufsize)) == NULL) ||
         (output_freqcbuf_base = maybe_shmalloc(bfconf->n_channels[OUT] * cbufsize)) == NULL ||
         (icomm = maybe_shmalloc(sizeof(struct intercomm_area))) == NULL)
     {
@@ -2146,11 +3198,51 @@ bfrun(void)
     for (int n = 0; n < bfconf->n_channels[IN]; n++) {
         input_freqcbuf[n] = input_freqcbuf_base;
         input_freqcbuf_base = (uint8_t *)input_freqcbuf_base + cbufsize;
+        if (input_timecbuf[n][0] != NULL) {
+            continue;
+        }
+        input_timecbuf[n][0] = input_timecbuf_base;
+        input_timecbuf[n][1] = (uint8_t *)input_timecbuf_base + cbufsize;
+        input_timecbuf_base = (uint8_t *)input_timecbuf_base + 2 * cbufsize;
     }
     for (int n = 0; n < bfconf->n_channels[OUT]; n++) {
         output_freqcbuf[n] = output_freqcbuf_base;
         output_freqcbuf_base = (uint8_t *)output_freqcbuf_base + cbufsize;
     }
+    for (int n = 0; n < bfconf->n_filters; n++) {
+        if (bfconf->filters[n].crossfade) {
+            need_xfadecbuf = true;
+        }
+        if (bfconf->filters[n].partition > 0 ||
+            bfconf->filters[n].n_filters[OUT] == 0)
+        {
+            /* the latter for dirac pulse filters */
+            need_timecbuf = true;
+        }
+    }
+    if (need_timecbuf) {
+        /* time-domain output of filters run in the time-domain */
+        if ((output_timecbuf_base = maybe_shmalloc(bfconf->n_channels[OUT] * cbufsize / 2)) == NULL) {
+            fprintf(stderr, "Failed to allocate shared memory: %s.\n", strerror(errno));
+            bf_exit(BF_EXIT_NO_MEMORY);
+            return;
+        }
+        for (int n = 0; n < bfconf->n_channels[OUT]; n++) {
+            output_timecbuf[n] = output_timecbuf_base;
+            output_timecbuf_base = (uint8_t *)output_timecbuf_base + cbufsize / 2;
+        }
+    }
+    if (need_xfadecbuf) {
+        if ((output_xfadecbuf_base = maybe_shmalloc(bfconf->n_channels[OUT] * cbufsize)) == NULL) {
+            fprintf(stderr, "Failed to allocate shared memory: %s.\n", strerror(errno));
+            bf_exit(BF_EXIT_NO_MEMORY);
+            return;
+        }
+        for (int n = 0; n < bfconf->n_channels[OUT]; n++) {
+            output_xfadecbuf[n] = output_xfadecbuf_base;
+            output_xfadecbuf_base = (uint8_t *)output_xfadecbuf_base + cbufsize;
+        }
+    }
 
     /* initialise process intercomm area */
     for (int n = 0; n < sizeof(struct intercomm_area); n++) {
@@ -2265,6 +3357,7 @@ bfrun(void)
         bfaccess.convolver_fftplan = convolver_fftplan;
         bfaccess.set_subdelay = set_subdelay;
         bfaccess.get_subdelay = get_subdelay;
+        bfaccess.coeff_usable = coeff_usable;
     }
 
     { // create filter processes
@@ -2298,6 +3391,9 @@ bfrun(void)
             fp_args->outbuf[1] = dai_buffers[OUT][1];
             fp_args->input_freqcbuf = input_freqcbuf;
             fp_args->output_freqcbuf = output_freqcbuf;
+            fp_args->output_xfadecbuf = need_xfadecbuf ? output_xfadecbuf : NULL;
+            fp_args->input_timecbuf = input_timecbuf;
+            fp_args->output_timecbuf = need_timecbuf ? output_timecbuf : NULL;
             fp_args->filter_readfd = &filter2filter_pipes[n];
             fp_args->filter_writefd = filter_writefd;
             fp_args->input_readfd = &bl_input_2_filter;
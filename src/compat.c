@@ -4,10 +4,13 @@
  * This program is open source. For license terms, see the LICENSE file.
  *
  */
+#define _GNU_SOURCE /* for memfd_create() */
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <ctype.h>
 #include <time.h>
+#include <sys/mman.h>
 #include <sys/prctl.h>
 
 #include "compat.h"
@@ -60,6 +63,42 @@ allocate_aligned_memory(size_t size, size_t alignment)
     return p;
 }
 
+void *
+allocate_mirrored_memory(size_t size)
+{
+#ifdef MFD_CLOEXEC
+    if (size == 0 || size % (size_t)sysconf(_SC_PAGESIZE) != 0) {
+        return NULL;
+    }
+    int fd = memfd_create("brutefir-ring", MFD_CLOEXEC);
+    if (fd == -1) {
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t)size) == -1) {
+        close(fd);
+        return NULL;
+    }
+    // reserve address space for both views, then map the same pages twice
+    uint8_t *p = mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    if (mmap(p, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(p + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        munmap(p, 2 * size);
+        close(fd);
+        return NULL;
+    }
+    close(fd);
+    return p;
+#else
+    (void)size;
+    return NULL;
+#endif
+}
+
 void
 set_thread_name(const char name[])
 {
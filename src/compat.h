@@ -26,6 +26,12 @@ number_of_cpu_cores(void);
 void *
 allocate_aligned_memory(size_t size, size_t alignment);
 
+// zeroed memory mapped twice back to back (p[i] is p[i + size]), size must be a
+// multiple of the page size. Shared mapping, so only one process may use it after
+// fork(). Returns NULL if not supported.
+void *
+allocate_mirrored_memory(size_t size);
+
 int
 posix_kill(pid_t pid, int sig);
 
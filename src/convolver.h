@@ -12,7 +12,9 @@
 #include "bfmod.h"
 #include "dai.h"
 
-/* Convert from raw sample format to the convolver's own time-domain format. */
+/* Convert from raw sample format to the convolver's own time-domain format.
+   The new block is converted to the start of 'next_cbuf' and copied to the
+   second half of 'cbuf', unless that is where 'next_cbuf' is. */
 void
 convolver_raw2cbuf(void *rawbuf,
                    void *cbuf,
@@ -51,11 +53,40 @@ convolver_convolve(void *input_cbuf,
                    void *coeffs,
                    void *output_cbuf);
 
+/* Crossfade from the output of the previous coefficient set to the output
+   of the current one, done in the frequency-domain. Costs three extra FFTs,
+   used for filters which output to other filters. */
 void
 convolver_crossfade_inplace(void *input_cbuf,
                             void *crossfade_cbuf,
                             void *buffer_cbuf);
 
+/* Crossfade in the time-domain (after convolver_freq2time()) from the output
+   in 'from_cbuf' to the output in 'to_cbuf', result stored in 'to_cbuf'. */
+void
+convolver_crossfade_time(void *from_cbuf,
+                         void *to_cbuf);
+
+/* Scale and mix 'n_samples' samples in the time-domain. The output buffer
+   may be the same as the first input buffer. */
+void
+convolver_td_mixnscale(void *input_bufs[],
+                       void *output_buf,
+                       double scales[],
+                       int n_bufs,
+                       int n_samples);
+
+/* Direct form FIR filtering in the time-domain of the last half of a buffer
+   in the convolver's own time-domain format, the first half is history. At
+   most one filter block length of coefficients may be used. The half-sized
+   scaled result is stored in 'output_buf'. */
+void
+convolver_td_fir(void *input_cbuf,
+                 void *coeffs,
+                 int n_coeffs,
+                 double scale,
+                 void *output_buf);
+
 /* Convolution in the frequency-domain, with the result added to the output. */
 void
 convolver_convolve_add(void *input_cbuf,
@@ -144,6 +175,35 @@ void
 convolver_td_convolve(td_conv_t *tdc,
                       void *overlap_block);
 
+/* Uniformly partitioned convolution with longer partitions than the filter
+   length. 'blocklen' must be a power of two, buffers are 2 x 'blocklen' long
+   and the frequency-domain format is the ordered one of the FFT lib, which
+   is not compatible with other convolver functions. */
+void *
+convolver_part_coeffs2cbuf(void *coeffs,
+                           int n_coeffs,
+                           double scale,
+                           int blocklen);
+
+void
+convolver_part_time2freq(void *cbuf,
+                         int blocklen);
+
+void
+convolver_part_convolve_add(void *input_cbuf,
+                            void *coeffs,
+                            void *output_cbuf,
+                            int blocklen);
+
+void
+convolver_part_freq2time(void *cbuf,
+                         int blocklen);
+
+/* Set the floating point unit of the calling thread to flush denormals to
+   zero, returns false if not supported on this platform */
+bool
+convolver_flush_denormals(void);
+
 /* Initialise convolver. Some convolvers may ignore 'config_filename' */
 bool
 convolver_init(const char config_filename[],
@@ -4,9 +4,18 @@
  * This program is open source. For license terms, see the LICENSE file.
  *
  */
+#include <inttypes.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
 #include "asmprot.h"
+#include "bfmod.h"
 
 #include <xmmintrin.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 void
 convolver_sse_convolve_add(void *input_cbuf,
@@ -32,6 +41,73 @@ convolver_sse_convolve_add(void *input_cbuf,
     ((float *)d)[4] = d2s;
 }
 
+void
+convolver_sse_td_fir(void *input,
+                     void *coeffs,
+                     int n_coeffs,
+                     float scale,
+                     void *output,
+                     int n_samples)
+{
+    float *x = (float *)input;
+    float *h = (float *)coeffs;
+    float *y = (float *)output;
+    __m128 s = _mm_set1_ps(scale);
+    __m128 a0, a1, c;
+    int n, i;
+
+    for (n = 0; n + 8 <= n_samples; n += 8) {
+        a0 = _mm_setzero_ps();
+        a1 = _mm_setzero_ps();
+        for (i = 0; i < n_coeffs; i++) {
+            c = _mm_set1_ps(h[i]);
+            a0 = _mm_add_ps(a0, _mm_mul_ps(c, _mm_loadu_ps(&x[n+0-i])));
+            a1 = _mm_add_ps(a1, _mm_mul_ps(c, _mm_loadu_ps(&x[n+4-i])));
+        }
+        _mm_store_ps(&y[n+0], _mm_mul_ps(a0, s));
+        _mm_store_ps(&y[n+4], _mm_mul_ps(a1, s));
+    }
+    for (; n < n_samples; n += 4) {
+        a0 = _mm_setzero_ps();
+        for (i = 0; i < n_coeffs; i++) {
+            c = _mm_set1_ps(h[i]);
+            a0 = _mm_add_ps(a0, _mm_mul_ps(c, _mm_loadu_ps(&x[n-i])));
+        }
+        _mm_store_ps(&y[n], _mm_mul_ps(a0, s));
+    }
+}
+
+void
+convolver_sse_td_mixnscale(void *inputs[],
+                           void *output,
+                           double scales[],
+                           int n_bufs,
+                           int n_samples)
+{
+    float **x = (float **)inputs;
+    float *y = (float *)output;
+    __m128 s;
+    int n, i;
+
+    s = _mm_set1_ps((float)scales[0]);
+    for (n = 0; n + 4 <= n_samples; n += 4) {
+        _mm_storeu_ps(&y[n], _mm_mul_ps(_mm_loadu_ps(&x[0][n]), s));
+    }
+    for (; n < n_samples; n++) {
+        y[n] = x[0][n] * (float)scales[0];
+    }
+    for (i = 1; i < n_bufs; i++) {
+        s = _mm_set1_ps((float)scales[i]);
+        for (n = 0; n + 4 <= n_samples; n += 4) {
+            _mm_storeu_ps(&y[n], _mm_add_ps(_mm_loadu_ps(&y[n]),
+                                            _mm_mul_ps(_mm_loadu_ps(&x[i][n]), s)));
+        }
+        for (; n < n_samples; n++) {
+            y[n] += x[i][n] * (float)scales[i];
+        }
+    }
+}
+
 #ifdef __SSE2__
 
 void
@@ -61,4 +137,802 @@ convolver_sse2_convolve_add(void *input_cbuf,
     ((double *)d)[4] = d2s;
 }
 
+void
+convolver_sse2_td_fir(void *input,
+                      void *coeffs,
+                      int n_coeffs,
+                      double scale,
+                      void *output,
+                      int n_samples)
+{
+    double *x = (double *)input;
+    double *h = (double *)coeffs;
+    double *y = (double *)output;
+    __m128d s = _mm_set1_pd(scale);
+    __m128d a0, a1, a2, a3, c;
+    int n, i;
+
+    for (n = 0; n + 8 <= n_samples; n += 8) {
+        a0 = _mm_setzero_pd();
+        a1 = _mm_setzero_pd();
+        a2 = _mm_setzero_pd();
+        a3 = _mm_setzero_pd();
+        for (i = 0; i < n_coeffs; i++) {
+            c = _mm_set1_pd(h[i]);
+            a0 = _mm_add_pd(a0, _mm_mul_pd(c, _mm_loadu_pd(&x[n+0-i])));
+            a1 = _mm_add_pd(a1, _mm_mul_pd(c, _mm_loadu_pd(&x[n+2-i])));
+            a2 = _mm_add_pd(a2, _mm_mul_pd(c, _mm_loadu_pd(&x[n+4-i])));
+            a3 = _mm_add_pd(a3, _mm_mul_pd(c, _mm_loadu_pd(&x[n+6-i])));
+        }
+        _mm_store_pd(&y[n+0], _mm_mul_pd(a0, s));
+        _mm_store_pd(&y[n+2], _mm_mul_pd(a1, s));
+        _mm_store_pd(&y[n+4], _mm_mul_pd(a2, s));
+        _mm_store_pd(&y[n+6], _mm_mul_pd(a3, s));
+    }
+    for (; n < n_samples; n += 2) {
+        a0 = _mm_setzero_pd();
+        for (i = 0; i < n_coeffs; i++) {
+            c = _mm_set1_pd(h[i]);
+            a0 = _mm_add_pd(a0, _mm_mul_pd(c, _mm_loadu_pd(&x[n-i])));
+        }
+        _mm_store_pd(&y[n], _mm_mul_pd(a0, s));
+    }
+}
+
+void
+convolver_sse2_td_mixnscale(void *inputs[],
+                            void *output,
+                            double scales[],
+                            int n_bufs,
+                            int n_samples)
+{
+    double **x = (double **)inputs;
+    double *y = (double *)output;
+    __m128d s;
+    int n, i;
+
+    s = _mm_set1_pd(scales[0]);
+    for (n = 0; n + 2 <= n_samples; n += 2) {
+        _mm_storeu_pd(&y[n], _mm_mul_pd(_mm_loadu_pd(&x[0][n]), s));
+    }
+    for (; n < n_samples; n++) {
+        y[n] = x[0][n] * scales[0];
+    }
+    for (i = 1; i < n_bufs; i++) {
+        s = _mm_set1_pd(scales[i]);
+        for (n = 0; n + 2 <= n_samples; n += 2) {
+            _mm_storeu_pd(&y[n], _mm_add_pd(_mm_loadu_pd(&y[n]),
+                                            _mm_mul_pd(_mm_loadu_pd(&x[i][n]), s)));
+        }
+        for (; n < n_samples; n++) {
+            y[n] += x[i][n] * scales[i];
+        }
+    }
+}
+
+/*
+ * Sample format conversion, four samples per step. Integer samples are
+ * loaded as sign extended 32 bit integers, lane by lane if interleaved, as
+ * SSE2 has no gather. Only little endian hosts, so swap means the samples
+ * are big endian. The functions return the number of samples converted,
+ * which is a multiple of four (zero if the format is not handled), the
+ * caller converts the rest.
+ */
+
+static inline __m128i
+bswap16_epi16(__m128i x)
+{
+    return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+static inline __m128i
+bswap32_epi32(__m128i x)
+{
+    x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xB1), 0xB1);
+    return bswap16_epi16(x);
+}
+
+static inline __m128i
+bswap64_epi64(__m128i x)
+{
+    return _mm_shuffle_epi32(bswap32_epi32(x), 0xB1);
+}
+
+static inline __m128i
+gather4_32(const uint8_t *p,
+           int stride)
+{
+    int32_t s[4];
+
+    memcpy(&s[0], p, 4);
+    memcpy(&s[1], p + stride, 4);
+    memcpy(&s[2], p + 2 * stride, 4);
+    memcpy(&s[3], p + 3 * stride, 4);
+    return _mm_setr_epi32(s[0], s[1], s[2], s[3]);
+}
+
+static inline void
+scatter4_32(uint8_t *p,
+            int stride,
+            int bytes,
+            __m128i x)
+{
+    int32_t s[4];
+
+    _mm_storeu_si128((__m128i *)s, x);
+    memcpy(p, &s[0], bytes);
+    memcpy(p + stride, &s[1], bytes);
+    memcpy(p + 2 * stride, &s[2], bytes);
+    memcpy(p + 3 * stride, &s[3], bytes);
+}
+
+/* packed 24 bit samples are read four bytes at a time, so the caller must
+   make sure there is at least one more byte after the fourth sample */
+static inline __m128i
+load4_int(const uint8_t *p,
+          int bytes,
+          int stride,
+          int swap)
+{
+    uint16_t s[4];
+    __m128i x;
+
+    switch (bytes) {
+    case 2:
+        if (stride == 2) {
+            x = _mm_loadl_epi64((const __m128i *)p);
+        } else {
+            memcpy(&s[0], p, 2);
+            memcpy(&s[1], p + stride, 2);
+            memcpy(&s[2], p + 2 * stride, 2);
+            memcpy(&s[3], p + 3 * stride, 2);
+            x = _mm_setr_epi16((short)s[0], (short)s[1], (short)s[2],
+                               (short)s[3], 0, 0, 0, 0);
+        }
+        if (swap) {
+            x = bswap16_epi16(x);
+        }
+        return _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+    case 3:
+        x = gather4_32(p, stride);
+        if (swap) {
+            return _mm_srai_epi32(bswap32_epi32(x), 8);
+        }
+        return _mm_srai_epi32(_mm_slli_epi32(x, 8), 8);
+    default:
+        x = (stride == 4) ? _mm_loadu_si128((const __m128i *)p) :
+            gather4_32(p, stride);
+        return swap ? bswap32_epi32(x) : x;
+    }
+}
+
+static inline void
+store4_int(uint8_t *p,
+           int bytes,
+           int stride,
+           int swap,
+           __m128i x)
+{
+    switch (bytes) {
+    case 2:
+        x = _mm_packs_epi32(x, x);
+        if (swap) {
+            x = bswap16_epi16(x);
+        }
+        if (stride == 2) {
+            _mm_storel_epi64((__m128i *)p, x);
+        } else {
+            *(uint16_t *)p = (uint16_t)_mm_extract_epi16(x, 0);
+            *(uint16_t *)(p + stride) = (uint16_t)_mm_extract_epi16(x, 1);
+            *(uint16_t *)(p + 2 * stride) = (uint16_t)_mm_extract_epi16(x, 2);
+            *(uint16_t *)(p + 3 * stride) = (uint16_t)_mm_extract_epi16(x, 3);
+        }
+        break;
+    case 3:
+        /* exactly three bytes per sample, the next byte may belong to
+           another channel */
+        if (swap) {
+            x = bswap32_epi32(_mm_slli_epi32(x, 8));
+        }
+        scatter4_32(p, stride, 3, x);
+        break;
+    default:
+        if (swap) {
+            x = bswap32_epi32(x);
+        }
+        if (stride == 4) {
+            _mm_storeu_si128((__m128i *)p, x);
+        } else {
+            scatter4_32(p, stride, 4, x);
+        }
+        break;
+    }
+}
+
+static inline __m128i
+load2_64(const uint8_t *p,
+         int stride,
+         int swap)
+{
+    __m128i x;
+
+    x = (stride == 8) ? _mm_loadu_si128((const __m128i *)p) :
+        _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)p),
+                           _mm_loadl_epi64((const __m128i *)(p + stride)));
+    return swap ? bswap64_epi64(x) : x;
+}
+
+static inline void
+store2_64(uint8_t *p,
+          int stride,
+          int swap,
+          __m128i x)
+{
+    if (swap) {
+        x = bswap64_epi64(x);
+    }
+    _mm_storel_epi64((__m128i *)p, x);
+    _mm_storel_epi64((__m128i *)(p + stride), _mm_unpackhi_epi64(x, x));
+}
+
+/* SSE2 lacks max_epi32 */
+static inline __m128i
+max_epi32(__m128i a,
+          __m128i b)
+{
+    __m128i m = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b));
+}
+
+static inline __m128i
+abs_epi32(__m128i x)
+{
+    __m128i s = _mm_srai_epi32(x, 31);
+    return _mm_sub_epi32(_mm_xor_si128(x, s), s);
+}
+
+/* two 64 bit lane masks to four 32 bit lane masks */
+static inline __m128i
+mask_pd2epi32(__m128d a,
+              __m128d b)
+{
+    return _mm_castps_si128(_mm_shuffle_ps(_mm_castpd_ps(a), _mm_castpd_ps(b),
+                                           _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+/* lanes with a non-zero absolute value below the smallest normal */
+static inline __m128
+denormal_ps(__m128 ax)
+{
+    return _mm_and_ps(_mm_cmplt_ps(ax, _mm_set1_ps(FLT_MIN)),
+                      _mm_cmpgt_ps(ax, _mm_setzero_ps()));
+}
+
+static inline __m128d
+denormal_pd(__m128d ax)
+{
+    return _mm_and_pd(_mm_cmplt_pd(ax, _mm_set1_pd(DBL_MIN)),
+                      _mm_cmpgt_pd(ax, _mm_setzero_pd()));
+}
+
+static inline double
+hmax4(__m128 x)
+{
+    float s[4];
+
+    _mm_storeu_ps(s, x);
+    return (double)fmaxf(fmaxf(s[0], s[1]), fmaxf(s[2], s[3]));
+}
+
+static inline double
+hmax2(__m128d x)
+{
+    double s[2];
+
+    _mm_storeu_pd(s, x);
+    return fmax(s[0], s[1]);
+}
+
+static inline int32_t
+hmax4_epi32(__m128i x)
+{
+    int32_t s[4], m;
+    int n;
+
+    _mm_storeu_si128((__m128i *)s, x);
+    for (m = s[0], n = 1; n < 4; n++) {
+        if (s[n] > m) {
+            m = s[n];
+        }
+    }
+    return m;
+}
+
+int
+convolver_sse2_raw2realf(void *realbuf,
+                         void *rawbuf,
+                         int bytes,
+                         int isfloat,
+                         int spacing,
+                         int swap,
+                         int n_samples)
+{
+    float *y = (float *)realbuf;
+    const uint8_t *p = (const uint8_t *)rawbuf;
+    const int stride = bytes * spacing;
+    int n = 0;
+
+    if (isfloat) {
+        if (bytes == 4) {
+            for (; n + 4 <= n_samples; n += 4, p += 4 * stride) {
+                _mm_storeu_si128((__m128i *)&y[n],
+                                 load4_int(p, 4, stride, swap));
+            }
+        } else if (bytes == 8) {
+            for (; n + 4 <= n_samples; n += 4, p += 4 * stride) {
+                __m128 a = _mm_cvtpd_ps(_mm_castsi128_pd(load2_64(p, stride, swap)));
+                __m128 b = _mm_cvtpd_ps(_mm_castsi128_pd(load2_64(p + 2 * stride, stride, swap)));
+                _mm_storeu_ps(&y[n], _mm_movelh_ps(a, b));
+            }
+        }
+        return n;
+    }
+    switch (bytes) {
+    case 2:
+        for (; n + 4 <= n_samples; n += 4, p += 4 * stride) {
+            _mm_storeu_ps(&y[n], _mm_cvtepi32_ps(load4_int(p, 2, stride, swap)));
+        }
+        break;
+    case 3:
+        /* leave the last sample, as a four byte read could pass the end */
+        for (; n + 4 < n_samples; n += 4, p += 4 * stride) {
+            _mm_storeu_ps(&y[n], _mm_cvtepi32_ps(load4_int(p, 3, stride, swap)));
+        }
+        break;
+    case 4:
+        for (; n + 4 <= n_samples; n += 4, p += 4 * stride) {
+            _mm_storeu_ps(&y[n], _mm_cvtepi32_ps(load4_int(p, 4, stride, swap)));
+        }
+        break;
+    }
+    return n;
+}
+
+int
+convolver_sse2_raw2reald(void *realbuf,
+                         void *rawbuf,
+                         int bytes,
+                         int isfloat,
+                         int spacing,
+                         int swap,
+                         int n_samples)
+{
+    double *y = (double *)realbuf;
+    const uint8_t *p = (const uint8_t *)rawbuf;
+    const int stride = bytes * spacing;
+    __m128i x;
+    int n = 0;
+
+    if (isfloat) {
+        if (bytes == 4) {
+            for (; n + 4 <= n_samples; n += 4, p += 4 * stride) {
+                __m128 a = _mm_castsi128_ps(load4_int(p, 4, stride, swap));
+                _mm_storeu_pd(&y[n], _mm_cvtps_pd(a));
+                _mm_storeu_pd(&y[n+2], _mm_cvtps_pd(_mm_movehl_ps(a, a)));
+            }
+        } else if (bytes == 8) {
+            for (; n + 4 <= n_samples; n += 4, p += 4 * stride) {
+                _mm_storeu_si128((__m128i *)&y[n], load2_64(p, stride, swap));
+                _mm_storeu_si128((__m128i *)&y[n+2],
+                                 load2_64(p + 2 * stride, stride, swap));
+            }
+        }
+        return n;
+    }
+    switch (bytes) {
+    case 2:
+        for (; n + 4 <= n_samples; n += 4, p += 4 * stride) {
+            x = load4_int(p, 2, stride, swap);
+            _mm_storeu_pd(&y[n], _mm_cvtepi32_pd(x));
+            _mm_storeu_pd(&y[n+2], _mm_cvtepi32_pd(_mm_srli_si128(x, 8)));
+        }
+        break;
+    case 3:
+        for (; n + 4 < n_samples; n += 4, p += 4 * stride) {
+            x = load4_int(p, 3, stride, swap);
+            _mm_storeu_pd(&y[n], _mm_cvtepi32_pd(x));
+            _mm_storeu_pd(&y[n+2], _mm_cvtepi32_pd(_mm_srli_si128(x, 8)));
+        }
+        break;
+    case 4:
+        for (; n + 4 <= n_samples; n += 4, p += 4 * stride) {
+            x = load4_int(p, 4, stride, swap);
+            _mm_storeu_pd(&y[n], _mm_cvtepi32_pd(x));
+            _mm_storeu_pd(&y[n+2], _mm_cvtepi32_pd(_mm_srli_si128(x, 8)));
+        }
+        break;
+    }
+    return n;
+}
+
+/*
+ * Without dither. Overflow bookkeeping is the same as for the scalar code,
+ * but collected per call. '*peak' is set to the largest absolute input
+ * sample, or NaN if there was a NaN, and '*denormal' to non-zero if there
+ * was a denormal, for the caller to test. The integer
+ * requantiser works in double precision also for float input, as the scalar
+ * real2rawf_no_dither() uses ditherd_real2int_no_dither(). Adding 0.5 in
+ * float would round away the fraction of samples above 2^23, so 24 and 32
+ * bit output could differ by one from the scalar code. The dithered
+ * requantisers below work in the precision of the input, like the scalar
+ * ones.
+ */
+
+struct requant {
+    __m128d rmin;
+    __m128d rmax;
+    __m128d largest;
+    __m128i intlargest;
+    unsigned int n_overflows;
+    int32_t imin;
+    int32_t imax;
+};
+
+static inline void
+requant_init(struct requant *q,
+             int bits)
+{
+    q->imin = -((uint64_t)1 << (bits - 1));
+    q->imax = ((uint64_t)1 << (bits - 1)) - 1;
+    q->rmin = _mm_set1_pd((double)q->imin);
+    q->rmax = _mm_set1_pd((double)q->imax);
+    q->largest = _mm_setzero_pd();
+    q->intlargest = _mm_setzero_si128();
+    q->n_overflows = 0;
+}
+
+/* add 0.5 and truncate downwards, where negative values are always
+   decremented after truncation, as in the scalar requantiser */
+static inline __m128i
+requant4(struct requant *q,
+         __m128d x0,
+         __m128d x1)
+{
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128d absmask =
+        _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+    __m128d y0, y1, lo0, lo1, hi0, hi1, clip0, clip1;
+    __m128i i, lo, hi, clip;
+
+    y0 = _mm_add_pd(x0, half);
+    y1 = _mm_add_pd(x1, half);
+    lo0 = _mm_cmple_pd(y0, q->rmin);
+    lo1 = _mm_cmple_pd(y1, q->rmin);
+    hi0 = _mm_cmpgt_pd(y0, q->rmax);
+    hi1 = _mm_cmpgt_pd(y1, q->rmax);
+    clip0 = _mm_or_pd(lo0, hi0);
+    clip1 = _mm_or_pd(lo1, hi1);
+    q->n_overflows += __builtin_popcount(_mm_movemask_pd(clip0)) +
+        __builtin_popcount(_mm_movemask_pd(clip1));
+    q->largest = _mm_max_pd(q->largest,
+                            _mm_max_pd(_mm_and_pd(clip0, _mm_and_pd(y0, absmask)),
+                                       _mm_and_pd(clip1, _mm_and_pd(y1, absmask))));
+
+    i = _mm_unpacklo_epi64(_mm_cvttpd_epi32(y0), _mm_cvttpd_epi32(y1));
+    i = _mm_add_epi32(i, mask_pd2epi32(_mm_cmplt_pd(y0, _mm_setzero_pd()),
+                                       _mm_cmplt_pd(y1, _mm_setzero_pd())));
+    lo = mask_pd2epi32(lo0, lo1);
+    hi = mask_pd2epi32(hi0, hi1);
+    clip = _mm_or_si128(lo, hi);
+    q->intlargest = max_epi32(q->intlargest,
+                              _mm_andnot_si128(clip, abs_epi32(i)));
+    return _mm_or_si128(_mm_andnot_si128(clip, i),
+                        _mm_or_si128(_mm_and_si128(lo, _mm_set1_epi32(q->imin)),
+                                     _mm_and_si128(hi, _mm_set1_epi32(q->imax))));
+}
+
+static inline void
+requant_finish(struct requant *q,
+               struct bfoverflow *overflow)
+{
+    int32_t intlargest = hmax4_epi32(q->intlargest);
+    double largest = hmax2(q->largest);
+
+    overflow->n_overflows += q->n_overflows;
+    if (intlargest > overflow->intlargest) {
+        overflow->intlargest = intlargest;
+    }
+    if (largest > overflow->largest) {
+        overflow->largest = largest;
+    }
+}
+
+int
+convolver_sse2_real2rawf(void *rawbuf,
+                         void *realbuf,
+                         int bits,
+                         int bytes,
+                         int isfloat,
+                         int spacing,
+                         int swap,
+                         int n_samples,
+                         struct bfoverflow *overflow,
+                         double *peak,
+                         int *denormal)
+{
+    const float *r = (const float *)realbuf;
+    uint8_t *p = (uint8_t *)rawbuf;
+    const int stride = bytes * spacing;
+    const __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 x, ax, vmax, vpeak, nan, den;
+    unsigned int n_overflows = 0;
+    struct requant q;
+    int n = 0;
+
+    if (bytes < 2 || (!isfloat && bytes > 4)) {
+        return 0;
+    }
+    vpeak = nan = den = _mm_setzero_ps();
+    if (isfloat) {
+        vmax = _mm_set1_ps((float)overflow->max);
+        for (; n + 4 <= n_samples; n += 4, p += 4 * stride) {
+            x = _mm_loadu_ps(&r[n]);
+            ax = _mm_and_ps(x, absmask);
+            nan = _mm_or_ps(nan, _mm_cmpunord_ps(x, x));
+            den = _mm_or_ps(den, denormal_ps(ax));
+            vpeak = _mm_max_ps(vpeak, ax);
+            n_overflows += __builtin_popcount(_mm_movemask_ps(_mm_cmpgt_ps(ax, vmax)));
+            if (bytes == 4) {
+                store4_int(p, 4, stride, swap, _mm_castps_si128(x));
+            } else {
+                store2_64(p, stride, swap, _mm_castpd_si128(_mm_cvtps_pd(x)));
+                store2_64(p + 2 * stride, stride, swap,
+                          _mm_castpd_si128(_mm_cvtps_pd(_mm_movehl_ps(x, x))));
+            }
+        }
+        overflow->n_overflows += n_overflows;
+        if (hmax4(vpeak) > overflow->largest) {
+            overflow->largest = hmax4(vpeak);
+        }
+    } else {
+        requant_init(&q, bits);
+        for (; n + 4 <= n_samples; n += 4, p += 4 * stride) {
+            x = _mm_loadu_ps(&r[n]);
+            ax = _mm_and_ps(x, absmask);
+            nan = _mm_or_ps(nan, _mm_cmpunord_ps(x, x));
+            den = _mm_or_ps(den, denormal_ps(ax));
+            vpeak = _mm_max_ps(vpeak, ax);
+            store4_int(p, bytes, stride, swap,
+                       requant4(&q, _mm_cvtps_pd(x),
+                                _mm_cvtps_pd(_mm_movehl_ps(x, x))));
+        }
+        requant_finish(&q, overflow);
+    }
+    *peak = (_mm_movemask_ps(nan) != 0) ? NAN : hmax4(vpeak);
+    *denormal = _mm_movemask_ps(den) != 0;
+    return n;
+}
+
+int
+convolver_sse2_real2rawd(void *rawbuf,
+                         void *realbuf,
+                         int bits,
+                         int bytes,
+                         int isfloat,
+                         int spacing,
+                         int swap,
+                         int n_samples,
+                         struct bfoverflow *overflow,
+                         double *peak,
+                         int *denormal)
+{
+    const double *r = (const double *)realbuf;
+    uint8_t *p = (uint8_t *)rawbuf;
+    const int stride = bytes * spacing;
+    const __m128d absmask =
+        _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+    __m128d x0, x1, ax0, ax1, vmax, vpeak, nan, den;
+    unsigned int n_overflows = 0;
+    struct requant q;
+    int n = 0;
+
+    if (bytes < 2 || (!isfloat && bytes > 4)) {
+        return 0;
+    }
+    vpeak = nan = den = _mm_setzero_pd();
+    if (!isfloat) {
+        requant_init(&q, bits);
+    }
+    vmax = _mm_set1_pd(overflow->max);
+    for (; n + 4 <= n_samples; n += 4, p += 4 * stride) {
+        x0 = _mm_loadu_pd(&r[n]);
+        x1 = _mm_loadu_pd(&r[n+2]);
+        ax0 = _mm_and_pd(x0, absmask);
+        ax1 = _mm_and_pd(x1, absmask);
+        nan = _mm_or_pd(nan, _mm_or_pd(_mm_cmpunord_pd(x0, x0),
+                                       _mm_cmpunord_pd(x1, x1)));
+        den = _mm_or_pd(den, _mm_or_pd(denormal_pd(ax0), denormal_pd(ax1)));
+        vpeak = _mm_max_pd(vpeak, _mm_max_pd(ax0, ax1));
+        if (!isfloat) {
+            store4_int(p, bytes, stride, swap, requant4(&q, x0, x1));
+            continue;
+        }
+        n_overflows +=
+            __builtin_popcount(_mm_movemask_pd(_mm_cmpgt_pd(ax0, vmax))) +
+            __builtin_popcount(_mm_movemask_pd(_mm_cmpgt_pd(ax1, vmax)));
+        if (bytes == 4) {
+            store4_int(p, 4, stride, swap,
+                       _mm_castps_si128(_mm_movelh_ps(_mm_cvtpd_ps(x0),
+                                                      _mm_cvtpd_ps(x1))));
+        } else {
+            store2_64(p, stride, swap, _mm_castpd_si128(x0));
+            store2_64(p + 2 * stride, stride, swap, _mm_castpd_si128(x1));
+        }
+    }
+    if (!isfloat) {
+        requant_finish(&q, overflow);
+    } else {
+        overflow->n_overflows += n_overflows;
+        if (hmax2(vpeak) > overflow->largest) {
+            overflow->largest = hmax2(vpeak);
+        }
+    }
+    *peak = (_mm_movemask_pd(nan) != 0) ? NAN : hmax2(vpeak);
+    *denormal = _mm_movemask_pd(den) != 0;
+    return n;
+}
+
+/*
+ * With HP TPDF dither. The error feedback makes each sample depend on the
+ * previous, so the requantiser runs one sample at a time, but without
+ * branches; loads, NaN/peak tests and stores are vectorised. 'noise' is the
+ * dither including the +0.5 offset, 'err' the error feedback state.
+ */
+int
+convolver_sse2_real2rawf_hp_tpdf(void *rawbuf,
+                                 void *realbuf,
+                                 int bits,
+                                 int bytes,
+                                 int spacing,
+                                 int swap,
+                                 int n_samples,
+                                 const float noise[],
+                                 float err[2],
+                                 struct bfoverflow *overflow,
+                                 double *peak,
+                                 int *denormal)
+{
+    const float *r = (const float *)realbuf;
+    uint8_t *p = (uint8_t *)rawbuf;
+    const int stride = bytes * spacing;
+    const __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const int32_t imin = -((uint64_t)1 << (bits - 1));
+    const int32_t imax = ((uint64_t)1 << (bits - 1)) - 1;
+    const float rmin = (float)imin, rmax = (float)imax;
+    float e0 = err[0], e1 = err[1], y, v, av, largest = 0.0f;
+    int32_t q[4], i, ai, intlargest = 0;
+    unsigned int n_overflows = 0;
+    __m128 x, ax, vpeak, nan, den;
+    int n, k, lo, hi, clip;
+
+    if (bytes < 2 || bytes > 4) {
+        return 0;
+    }
+    vpeak = nan = den = _mm_setzero_ps();
+    for (n = 0; n + 4 <= n_samples; n += 4, p += 4 * stride) {
+        x = _mm_loadu_ps(&r[n]);
+        ax = _mm_and_ps(x, absmask);
+        nan = _mm_or_ps(nan, _mm_cmpunord_ps(x, x));
+        den = _mm_or_ps(den, denormal_ps(ax));
+        vpeak = _mm_max_ps(vpeak, ax);
+        for (k = 0; k < 4; k++) {
+            /* error feedback with coefficients {1, -1} (high pass) */
+            y = r[n+k] + (e0 - e1);
+            e1 = e0;
+            v = y + noise[n+k];
+            lo = v <= rmin;
+            hi = v > rmax;
+            clip = lo | hi;
+            i = _mm_cvttss_si32(_mm_set_ss(v)) - (v < 0.0f);
+            i = lo ? imin : i;
+            i = hi ? imax : i;
+            e0 = y - (float)i;
+            n_overflows += clip;
+            av = fabsf(v);
+            largest = (clip && av > largest) ? av : largest;
+            ai = i < 0 ? -i : i;
+            intlargest = (!clip && ai > intlargest) ? ai : intlargest;
+            q[k] = i;
+        }
+        store4_int(p, bytes, stride, swap, _mm_loadu_si128((__m128i *)q));
+    }
+    err[0] = e0;
+    err[1] = e1;
+    overflow->n_overflows += n_overflows;
+    if (intlargest > overflow->intlargest) {
+        overflow->intlargest = intlargest;
+    }
+    if ((double)largest > overflow->largest) {
+        overflow->largest = (double)largest;
+    }
+    *peak = (_mm_movemask_ps(nan) != 0) ? NAN : hmax4(vpeak);
+    *denormal = _mm_movemask_ps(den) != 0;
+    return n;
+}
+
+int
+convolver_sse2_real2rawd_hp_tpdf(void *rawbuf,
+                                 void *realbuf,
+                                 int bits,
+                                 int bytes,
+                                 int spacing,
+                                 int swap,
+                                 int n_samples,
+                                 const double noise[],
+                                 double err[2],
+                                 struct bfoverflow *overflow,
+                                 double *peak,
+                                 int *denormal)
+{
+    const double *r = (const double *)realbuf;
+    uint8_t *p = (uint8_t *)rawbuf;
+    const int stride = bytes * spacing;
+    const __m128d absmask =
+        _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+    const int32_t imin = -((uint64_t)1 << (bits - 1));
+    const int32_t imax = ((uint64_t)1 << (bits - 1)) - 1;
+    const double rmin = (double)imin, rmax = (double)imax;
+    double e0 = err[0], e1 = err[1], y, v, av, largest = 0.0;
+    int32_t q[4], i, ai, intlargest = 0;
+    unsigned int n_overflows = 0;
+    __m128d x0, x1, ax0, ax1, vpeak, nan, den;
+    int n, k, lo, hi, clip;
+
+    if (bytes < 2 || bytes > 4) {
+        return 0;
+    }
+    vpeak = nan = den = _mm_setzero_pd();
+    for (n = 0; n + 4 <= n_samples; n += 4, p += 4 * stride) {
+        x0 = _mm_loadu_pd(&r[n]);
+        x1 = _mm_loadu_pd(&r[n+2]);
+        ax0 = _mm_and_pd(x0, absmask);
+        ax1 = _mm_and_pd(x1, absmask);
+        nan = _mm_or_pd(nan, _mm_or_pd(_mm_cmpunord_pd(x0, x0),
+                                       _mm_cmpunord_pd(x1, x1)));
+        den = _mm_or_pd(den, _mm_or_pd(denormal_pd(ax0), denormal_pd(ax1)));
+        vpeak = _mm_max_pd(vpeak, _mm_max_pd(ax0, ax1));
+        for (k = 0; k < 4; k++) {
+            y = r[n+k] + (e0 - e1);
+            e1 = e0;
+            v = y + noise[n+k];
+            lo = v <= rmin;
+            hi = v > rmax;
+            clip = lo | hi;
+            i = _mm_cvttsd_si32(_mm_set_sd(v)) - (v < 0.0);
+            i = lo ? imin : i;
+            i = hi ? imax : i;
+            e0 = y - (double)i;
+            n_overflows += clip;
+            av = fabs(v);
+            largest = (clip && av > largest) ? av : largest;
+            ai = i < 0 ? -i : i;
+            intlargest = (!clip && ai > intlargest) ? ai : intlargest;
+            q[k] = i;
+        }
+        store4_int(p, bytes, stride, swap, _mm_loadu_si128((__m128i *)q));
+    }
+    err[0] = e0;
+    err[1] = e1;
+    overflow->n_overflows += n_overflows;
+    if (intlargest > overflow->intlargest) {
+        overflow->intlargest = intlargest;
+    }
+    if (largest > overflow->largest) {
+        overflow->largest = largest;
+    }
+    *peak = (_mm_movemask_pd(nan) != 0) ? NAN : hmax2(vpeak);
+    *denormal = _mm_movemask_pd(den) != 0;
+    return n;
+}
+
 #endif
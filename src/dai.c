@@ -13,7 +13,12 @@
 #include <sys/time.h>
 #include <sys/wait.h>
 #include <sys/shm.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
 #include <sched.h>
+#include <poll.h>
+#include <pthread.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <inttypes.h>
@@ -64,8 +69,20 @@ struct subdev {
     struct dai_channels channels;
     delaybuffer_t **db;
     struct bfio_module *module;
+    bool pollable;  /* fd can be waited for, else it is always tried */
+    bool armed;     /* fd is armed in the epoll set */
+    bool ready;     /* fd has been reported ready */
+    bool pending;   /* not yet done in the current period */
     struct {
-        int iodelay_fill;
+        pthread_t thread;
+        bf_sem_t go;
+        uint8_t *buf;
+        int io;
+        int eof_frames;
+        int timer_fd;   /* wakes up devices which are always tried */
+    } iothread;
+    struct {
+        int iodelay_fill; /* frames */
         int curbuf;
         volatile int frames_left;
     } cb;
@@ -92,15 +109,18 @@ static struct {
     void *iobuffers[2][2];
     int n_devs[2];
     int n_fd_devs[2];
-    fd_set dev_fds[2];
-    fd_set clocked_wfds;
-    int n_clocked_devs;
-    int dev_fdn[2];
+    int epoll_fd[2];
+    int poll_timer_fd;
+    bool parallel_io[2];
+    int latch_fd[2];
     int min_block_size[2];
     int cb_min_block_size[2];
     bool input_poll_mode;
+    bool cb_single_thread;
+    bool cb_direct;
+    void *cb_direct_buf[2][BF_MAXCHANNELS];
+    void *cb_zerobuf;
     struct subdev *dev[2][BF_MAXCHANNELS];
-    struct subdev *fd2dev[2][FD_SETSIZE];
     struct subdev *ch2dev[2][BF_MAXCHANNELS];
     int period_size;
     int sample_rate;
@@ -117,15 +137,18 @@ static struct {
     .iobuffers = {},
     .n_devs = { 0, 0 },
     .n_fd_devs = { 0, 0 },
-    .dev_fds = {},
-    .clocked_wfds = {},
-    .n_clocked_devs = 0,
-    .dev_fdn = { 0, 0 },
+    .epoll_fd = { -1, -1 },
+    .poll_timer_fd = -1,
+    .parallel_io = { false, false },
+    .latch_fd = { -1, -1 },
     .min_block_size = { 0, 0 },
     .cb_min_block_size = { 0, 0 },
     .input_poll_mode = false,
+    .cb_single_thread = false,
+    .cb_direct = false,
+    .cb_direct_buf = {},
+    .cb_zerobuf = NULL,
     .dev = {},
-    .fd2dev = {},
     .ch2dev = {},
     .period_size = 0,
     .sample_rate = 0,
@@ -151,6 +174,10 @@ static void
 cbmutex(int io,
         bool lock)
 {
+    if (glob.cb_single_thread) {
+        /* only one thread ever enters the callback code, nothing to lock */
+        return;
+    }
     if (lock) {
         bf_sem_wait(&glob.cbmutex_pipe[io]);
     } else {
@@ -182,13 +209,6 @@ update_devmap(const int idx,
               const int io)
 {
     struct subdev *sd = glob.dev[io][idx];
-    if (sd->fd >= 0) {
-        FD_SET(sd->fd, &glob.dev_fds[io]);
-        if (sd->fd > glob.dev_fdn[io]) {
-            glob.dev_fdn[io] = sd->fd;
-        }
-        glob.fd2dev[io][sd->fd] = sd;
-    }
     for (int n = 0; n < sd->channels.used_channels; n++) {
         glob.ch2dev[io][sd->channels.channel_name[n]] = sd;
     }
@@ -413,8 +433,8 @@ init_input(const struct dai_subdevice *dai_subdev,
     sd->isinterleaved = !!isinterleaved;
     if (sd->uses_callback) {
         sd->fd = -1;
-        if (sd->block_size_frames == 0 || glob.period_size % sd->block_size_frames != 0) {
-            fprintf(stderr, "Invalid block size for callback input. Got %d, expected multiple of %d.\n",
+        if (sd->block_size_frames <= 0 || sd->block_size_frames > glob.period_size) {
+            fprintf(stderr, "Invalid block size for callback input. Got %d, expected at most %d.\n",
                     sd->block_size_frames, glob.period_size);
             return false;
         }
@@ -478,8 +498,9 @@ init_output(const struct dai_subdevice *dai_subdev,
     sd->isinterleaved = !!isinterleaved;
     if (sd->uses_callback) {
         sd->fd = -1;
-        if (sd->block_size_frames == 0 || glob.period_size % sd->block_size_frames != 0) {
-            fprintf(stderr, "Invalid block size for callback output.\n");
+        if (sd->block_size_frames <= 0 || sd->block_size_frames > glob.period_size) {
+            fprintf(stderr, "Invalid block size for callback output. Got %d, expected at most %d.\n",
+                    sd->block_size_frames, glob.period_size);
             return false;
         }
         if (sd->uses_clock && (sd->block_size_frames < glob.cb_min_block_size[OUT] || glob.cb_min_block_size[OUT] == 0)) {
@@ -488,10 +509,6 @@ init_output(const struct dai_subdevice *dai_subdev,
     } else {
         glob.n_fd_devs[OUT]++;
         sd->fd = fd;
-        if (sd->uses_clock) {
-            FD_SET(sd->fd, &glob.clocked_wfds);
-            glob.n_clocked_devs++;
-        }
         if (sd->uses_clock &&
             sd->block_size_frames != 0 &&
             (sd->block_size_frames < glob.min_block_size[OUT] ||
@@ -587,6 +604,436 @@ handle_params(const int io)
     efree(msgstr);
 }
 
+/*
+  The blocking I/O devices are waited for with epoll, each registered
+  one-shot so it is reported once until re-armed, which is done when it is
+  pending in the current period. File descriptors which epoll cannot wait
+  for (regular files, or a descriptor shared by several devices) are always
+  ready as they would be in select(), and are tried every loop.
+*/
+static void
+iowait_init(const int io)
+{
+    struct epoll_event ev;
+
+    if ((glob.epoll_fd[io] = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+        fprintf(stderr, "Failed to create epoll instance: %s.\n", strerror(errno));
+        bf_exit(BF_EXIT_OTHER);
+    }
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(glob.epoll_fd[io], EPOLL_CTL_ADD, glob.paramspipe_s[io][0], &ev) == -1) {
+        fprintf(stderr, "Failed to add pipe to epoll set: %s.\n", strerror(errno));
+        bf_exit(BF_EXIT_OTHER);
+    }
+    for (int n = 0; n < glob.n_devs[io]; n++) {
+        struct subdev *sd = glob.dev[io][n];
+        if (sd->uses_callback) {
+            continue;
+        }
+        ev.events = (io == IN ? EPOLLIN : EPOLLOUT) | EPOLLONESHOT;
+        ev.data.ptr = sd;
+        sd->ready = false;
+        if (epoll_ctl(glob.epoll_fd[io], EPOLL_CTL_ADD, sd->fd, &ev) == 0) {
+            sd->pollable = true;
+            sd->armed = true;
+        } else if (errno == EPERM || errno == EEXIST) {
+            sd->pollable = false;
+            sd->armed = false;
+        } else {
+            fprintf(stderr, "Failed to add device to epoll set: %s.\n", strerror(errno));
+            bf_exit(BF_EXIT_OTHER);
+        }
+    }
+    if (io == IN && glob.input_poll_mode) {
+        /* poll mode devices are read on timer wakeups */
+        if ((glob.poll_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)) == -1) {
+            fprintf(stderr, "Failed to create timer: %s.\n", strerror(errno));
+            bf_exit(BF_EXIT_OTHER);
+        }
+        ev.events = EPOLLIN;
+        ev.data.ptr = &glob.poll_timer_fd;
+        if (epoll_ctl(glob.epoll_fd[io], EPOLL_CTL_ADD, glob.poll_timer_fd, &ev) == -1) {
+            fprintf(stderr, "Failed to add timer to epoll set: %s.\n", strerror(errno));
+            bf_exit(BF_EXIT_OTHER);
+        }
+    }
+}
+
+static void
+iowait_arm(const int io,
+           struct subdev *sd)
+{
+    if (!sd->pollable || sd->armed) {
+        return;
+    }
+    struct epoll_event ev;
+    ev.events = (io == IN ? EPOLLIN : EPOLLOUT) | EPOLLONESHOT;
+    ev.data.ptr = sd;
+    if (epoll_ctl(glob.epoll_fd[io], EPOLL_CTL_MOD, sd->fd, &ev) == -1) {
+        /* a module may have replaced the file behind the descriptor
+           with dup2(), then it needs to be added again */
+        if (errno != ENOENT || epoll_ctl(glob.epoll_fd[io], EPOLL_CTL_ADD, sd->fd, &ev) == -1) {
+            if (errno == EPERM) {
+                sd->pollable = false;
+                return;
+            }
+            fprintf(stderr, "Failed to arm device in epoll set: %s.\n", strerror(errno));
+            bf_exit(BF_EXIT_OTHER);
+        }
+    }
+    sd->armed = true;
+}
+
+/* wait for devices to become ready, or the poll timer to expire after
+   timeout_us microseconds, -1 is forever and 0 does not wait */
+static int
+iowait(const int io,
+       const int64_t timeout_us)
+{
+    struct epoll_event events[BF_MAXCHANNELS + 2];
+    int timeout = timeout_us == 0 ? 0 : -1;
+
+    if (timeout_us > 0) {
+        struct itimerspec its;
+        memset(&its, 0, sizeof(its));
+        its.it_value.tv_sec = timeout_us / 1000000;
+        its.it_value.tv_nsec = (timeout_us % 1000000) * 1000;
+        if (timerfd_settime(glob.poll_timer_fd, 0, &its, NULL) == -1) {
+            fprintf(stderr, "Failed to set timer: %s.\n", strerror(errno));
+            bf_exit(BF_EXIT_OTHER);
+        }
+    }
+    int n_events;
+    while ((n_events = epoll_wait(glob.epoll_fd[io], events, BF_MAXCHANNELS + 2, timeout)) == -1 && errno == EINTR);
+    if (n_events == -1) {
+        fprintf(stderr, "Waiting for I/O failed: %s.\n", strerror(errno));
+        bf_exit(BF_EXIT_OTHER);
+    }
+    for (int n = 0; n < n_events; n++) {
+        if (events[n].data.ptr == NULL) {
+            handle_params(io);
+        } else if (events[n].data.ptr == &glob.poll_timer_fd) {
+            uint64_t expirations;
+            if (read(glob.poll_timer_fd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) {
+                fprintf(stderr, "Failed to read timer: %s.\n", strerror(errno));
+                bf_exit(BF_EXIT_OTHER);
+            }
+        } else {
+            struct subdev *sd = (struct subdev *)events[n].data.ptr;
+            sd->armed = false;
+            sd->ready = true;
+        }
+    }
+    return n_events;
+}
+
+static void
+read_error(void)
+{
+    switch (errno) {
+    case EINTR:
+    case EAGAIN:
+        /* try again later */
+        break;
+    case EIO:
+        /* invalid input signal */
+        fprintf(stderr, "I/O module failed to read due to invalid input signal, aborting.\n");
+        bf_exit(BF_EXIT_INVALID_INPUT);
+        break;
+    case EPIPE:
+        /* buffer underflow */
+
+        /* Actually, this should be overflow, but since we have
+           linked the devices, broken pipe on output will be
+           noted on the input as well, and it is more likely that
+           it is an underflow on the output than an overflow on
+           the input */
+        fprintf(stderr, "I/O module failed to read (probably) due to buffer underflow on output, aborting.\n");
+        bf_exit(BF_EXIT_BUFFER_UNDERFLOW);
+        break;
+    default:
+        /* general error */
+        fprintf(stderr, "I/O module failed to read, aborting.\n");
+        bf_exit(BF_EXIT_OTHER);
+        break;
+    }
+}
+
+static void
+write_error(void)
+{
+    switch (errno) {
+    case EINTR:
+    case EAGAIN:
+        /* try again later */
+        break;
+    case EPIPE:
+        /* buffer underflow */
+        fprintf(stderr, "I/O module failed to write due to buffer underflow, aborting.\n");
+        bf_exit(BF_EXIT_BUFFER_UNDERFLOW);
+        break;
+    default:
+        /* general error */
+        fprintf(stderr, "I/O module failed to write, aborting.\n");
+        bf_exit(BF_EXIT_OTHER);
+        break;
+    }
+}
+
+/* end of input, clear what was not read and return the frames read */
+static int
+input_eof(struct subdev *sd,
+          uint8_t *buf)
+{
+    if (sd->isinterleaved) {
+        memset(buf + sd->buf_offset + sd->buf_size - sd->buf_left, 0, sd->buf_left);
+    } else {
+        const int i = sd->buf_size / sd->channels.open_channels;
+        const int k = sd->buf_left / sd->channels.open_channels;
+        for (int n = 1; n <= sd->channels.open_channels; n++) {
+            memset(buf + sd->buf_offset + n * i - k, 0, k);
+        }
+    }
+    return (sd->buf_size - sd->buf_left) / sd->channels.sf.bytes / sd->channels.open_channels;
+}
+
+static void
+measure_rate(const int frames,
+             const bool period_done)
+{
+    static struct {
+        bool startmeasure;
+        int frames;
+        struct timeval starttv;
+    } st = {
+        .startmeasure = true,
+        .frames = 0,
+        .starttv = {0}
+    };
+
+    if (st.startmeasure) {
+        if (period_done) {
+            st.startmeasure = false;
+            gettimeofday(&st.starttv, NULL);
+        }
+        return;
+    }
+    st.frames += frames;
+    if (st.frames >= glob.sample_rate && period_done) {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        timersub(&tv, &st.starttv, &tv);
+        double measured_rate = 1000.0 * (double)st.frames / (double)(tv.tv_sec * 1000 + tv.tv_usec / 1000);
+        if (bfconf->debug) {
+            fprintf(stderr, "measured rate: %.3f kHz (%d frames / %ld usecs)\n",
+                    measured_rate / 1000.0, st.frames, tv.tv_sec * 1000000 + tv.tv_usec);
+        }
+        if (measured_rate < (double)glob.sample_rate * 0.98 ||
+            measured_rate > (double)glob.sample_rate / 0.98)
+        {
+            fprintf(stderr, "Configured sample rate is %.1f kHz, but measured is %.1f kHz, aborting.\n",
+                    (double)glob.sample_rate / 1000.0, measured_rate / 1000.0);
+            bf_exit(BF_EXIT_INVALID_INPUT);
+        }
+        st.startmeasure = true;
+        st.frames = 0;
+    }
+}
+
+/*
+  With parallel I/O each blocking device has its own thread, which waits
+  for its device and transfers a full period on its own. When done it
+  counts down the latch, an eventfd the input or output process waits on
+  until all devices of the period are done. Commands to the I/O modules
+  are served between periods, so they never run concurrently with a device
+  transfer.
+*/
+static void
+iothread_wait(const int fd,
+              const short events)
+{
+    struct pollfd pfd = { .fd = fd, .events = events, .revents = 0 };
+    while (poll(&pfd, 1, -1) == -1) {
+        if (errno != EINTR) {
+            fprintf(stderr, "Waiting for I/O failed: %s.\n", strerror(errno));
+            bf_exit(BF_EXIT_OTHER);
+        }
+    }
+}
+
+/* sleep on the thread's timer for timeout_us microseconds */
+static void
+iothread_sleep(struct subdev *sd,
+               const int64_t timeout_us)
+{
+    struct itimerspec its;
+    uint64_t expirations;
+
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = timeout_us / 1000000;
+    its.it_value.tv_nsec = (timeout_us % 1000000) * 1000;
+    if (timerfd_settime(sd->iothread.timer_fd, 0, &its, NULL) == -1) {
+        fprintf(stderr, "Failed to set timer: %s.\n", strerror(errno));
+        bf_exit(BF_EXIT_OTHER);
+    }
+    iothread_wait(sd->iothread.timer_fd, POLLIN);
+    if (read(sd->iothread.timer_fd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) {
+        fprintf(stderr, "Failed to read timer: %s.\n", strerror(errno));
+        bf_exit(BF_EXIT_OTHER);
+    }
+}
+
+static void
+iothread_read(struct subdev *sd)
+{
+    // if poll mode or bad alignment, always poll for data
+    const bool force = sd->uses_clock && (glob.input_poll_mode || sd->bad_alignment);
+    uint8_t *buf = sd->iothread.buf;
+
+    while (true) {
+        if (!force) {
+            iothread_wait(sd->fd, POLLIN);
+        }
+        const int byte_count = sd->module->read(sd->fd, buf + sd->buf_offset, sd->buf_size - sd->buf_left, sd->buf_left);
+        switch (byte_count) {
+        case -1:
+            read_error();
+            break;
+        case 0:
+            sd->iothread.eof_frames = input_eof(sd, buf);
+            return;
+        default:
+            sd->buf_left -= byte_count;
+            if (sd->buf_left == 0) {
+                sd->buf_left = sd->buf_size;
+                return;
+            }
+            break;
+        }
+        if (force) {
+            /* wait until a block should be ready */
+            int64_t usec = (int64_t)(sd->buf_left / (sd->buf_size / glob.period_size)) * 1000000 / (int64_t)glob.sample_rate;
+            if (glob.min_block_size[IN] > 0) {
+                int64_t usec2 = (int64_t)glob.min_block_size[IN] * 1000000 / (int64_t)glob.sample_rate;
+                if (usec2 < usec) {
+                    usec = usec2;
+                }
+            }
+            if (usec > 50) {
+                iothread_sleep(sd, usec - 50);
+            }
+        }
+    }
+}
+
+static void
+iothread_write(struct subdev *sd)
+{
+    uint8_t *buf = sd->iothread.buf;
+
+    while (sd->buf_left != 0) {
+        iothread_wait(sd->fd, POLLOUT);
+        int write_size;
+        if (sd->block_size > 0 && sd->buf_left > sd->block_size) {
+            write_size = sd->block_size + sd->buf_left % sd->block_size;
+        } else {
+            write_size = sd->buf_left;
+        }
+        do_mute(sd, OUT, write_size, (void *)(buf + sd->buf_offset), sd->buf_size - sd->buf_left);
+        const int byte_count = sd->module->write(sd->fd, buf + sd->buf_offset, sd->buf_size - sd->buf_left, write_size);
+        if (byte_count == -1) {
+            write_error();
+        } else {
+            sd->buf_left -= byte_count;
+        }
+    }
+    sd->buf_left = sd->buf_size;
+}
+
+static void *
+iothread(void *arg)
+{
+    struct subdev *sd = (struct subdev *)arg;
+    const int io = sd->iothread.io;
+
+    set_thread_name(io == IN ? "input-io" : "output-io");
+    while (true) {
+        bf_sem_wait(&sd->iothread.go);
+        if (io == IN) {
+            iothread_read(sd);
+        } else {
+            iothread_write(sd);
+        }
+        const uint64_t one = 1;
+        if (write(glob.latch_fd[io], &one, sizeof(one)) != sizeof(one)) {
+            fprintf(stderr, "Failed to count down I/O latch: %s.\n", strerror(errno));
+            bf_exit(BF_EXIT_OTHER);
+        }
+    }
+    return NULL;
+}
+
+static void
+iothreads_init(const int io)
+{
+    if ((glob.latch_fd[io] = eventfd(0, EFD_CLOEXEC)) == -1) {
+        fprintf(stderr, "Failed to create I/O latch: %s.\n", strerror(errno));
+        bf_exit(BF_EXIT_OTHER);
+    }
+    for (int n = 0; n < glob.n_devs[io]; n++) {
+        struct subdev *sd = glob.dev[io][n];
+        if (sd->uses_callback) {
+            continue;
+        }
+        bf_sem_init(&sd->iothread.go);
+        sd->iothread.io = io;
+        sd->iothread.eof_frames = -1;
+        sd->iothread.timer_fd = -1;
+        if (io == IN && sd->uses_clock && (glob.input_poll_mode || sd->bad_alignment)) {
+            if ((sd->iothread.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)) == -1) {
+                fprintf(stderr, "Failed to create timer: %s.\n", strerror(errno));
+                bf_exit(BF_EXIT_OTHER);
+            }
+        }
+        int error;
+        if ((error = pthread_create(&sd->iothread.thread, NULL, iothread, sd)) != 0) {
+            fprintf(stderr, "pthread_create() failed: %s.\n", strerror(error));
+            bf_exit(BF_EXIT_OTHER);
+        }
+    }
+}
+
+/* transfer a period on all blocking devices in parallel */
+static void
+iothreads_run(const int io,
+              uint8_t *buf)
+{
+    int devsleft = 0;
+    for (int n = 0; n < glob.n_devs[io]; n++) {
+        struct subdev *sd = glob.dev[io][n];
+        if (sd->uses_callback) {
+            continue;
+        }
+        sd->iothread.buf = buf;
+        sd->iothread.eof_frames = -1;
+        bf_sem_post(&sd->iothread.go);
+        devsleft++;
+    }
+    while (devsleft != 0) {
+        uint64_t count;
+        if (read(glob.latch_fd[io], &count, sizeof(count)) != sizeof(count)) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "Failed to wait for I/O latch: %s.\n", strerror(errno));
+            bf_exit(BF_EXIT_OTHER);
+        }
+        devsleft -= (int)count;
+    }
+    iowait(io, 0);
+}
+
 static bool
 callback_init(int n_subdevs[2],
               struct dai_subdevice *subdevs[2])
@@ -613,21 +1060,6 @@ callback_init(int n_subdevs[2],
             return false;
         }
     }
-
-    FOR_IN_AND_OUT {
-        for (int n = 0; n < n_subdevs[IO]; n++) {
-            if (!bfconf->iomods[subdevs[IO][n].module].iscallback) {
-                continue;
-            }
-            if (glob.dev[IO][n]->bad_alignment) {
-                fprintf(stderr, "\
-Error: currently no support for bad callback I/O block alignment.\n\
-  BruteFIR's partition length must be divisable with the sound server's\n\
-  buffer size.\n");
-                return false;
-            }
-        }
-    }
     return true;
 }
 
@@ -724,6 +1156,54 @@ callback_process_thread(void *arg)
     callback_process(a.n_subdevs, a.subdevs, NULL);
 }
 
+/*
+  Frames of silence output before the first period. The callback I/O
+  buffers are double buffered, so while the callback copies frames in and
+  out of one buffer the filter works with the other. The filter is
+  triggered in the callback which completes an input period and waited for
+  in the callback which starts the corresponding output period, and the
+  time between those two is what the filter gets beyond the callback itself.
+
+  With the server block size evenly dividing the partition, periods begin
+  and end at block boundaries and a delay of 2 * (period - block) gives the
+  filter period - block frames of time. When they do not divide evenly a
+  period boundary can fall anywhere within a block, so the output is
+  delayed one block more. This keeps the two buffers apart at worst case
+  alignment, for any block size up to the partition length, but the
+  time given to the filter varies from period to period. With the block
+  size at most half the partition there is always at least one callback
+  between trigger and wait. Above half some periods are waited for in
+  the same callback they are triggered in (for a partition of 64, every
+  block size from 33 to 63), so like with block size equal to the
+  partition the filter must then finish within the server's cycle. A
+  longer delay would need more than two buffers, since the input of the
+  period after next would overwrite the buffer not yet output.
+
+  In synchronous mode the filter is instead waited for in the same callback
+  as it is triggered, and the delay is the least which never needs an
+  output period before the block completing its input has been copied.
+  With the block size equal to the partition length there is no delay.
+*/
+static int
+callback_iodelay_fill(const int block_size_frames)
+{
+    if (bfconf->sync_callback_io) {
+        int64_t fill = 0;
+        for (int64_t k = 0; k < block_size_frames; k++) {
+            const int64_t last = (k + 1) * glob.period_size - 1;
+            const int64_t f = last - last % block_size_frames - k * glob.period_size;
+            if (f > fill) {
+                fill = f;
+            }
+        }
+        return (int)fill;
+    }
+    if (glob.period_size % block_size_frames == 0) {
+        return 2 * (glob.period_size - block_size_frames);
+    }
+    return 2 * glob.period_size - block_size_frames;
+}
+
 bool
 dai_init(int _period_size,
          int rate,
@@ -731,15 +1211,42 @@ dai_init(int _period_size,
          struct dai_subdevice *subdevs[2],
          void *buffers[2][2])
 {
-    FD_ZERO(&glob.dev_fds[IN]);
-    FD_ZERO(&glob.dev_fds[OUT]);
-    FD_ZERO(&glob.clocked_wfds);
-    memset(glob.fd2dev, 0, sizeof(glob.fd2dev));
     memset(glob.ch2dev, 0, sizeof(glob.ch2dev));
 
     glob.period_size = _period_size;
     glob.sample_rate = rate;
 
+    /*
+      If all callback devices belong to the same module, process_callback()
+      is only ever called from that module's single server thread, with all
+      devices in the same call. Then, unless there are blocking devices
+      which may call output_finish() concurrently, the callback state needs
+      no locking, and the only synchronisation left is the period handoff
+      to and from the filter processes.
+
+      The handoff itself stays a copy into the double buffered I/O buffers
+      and a semaphore post. The server's buffers are only valid during the
+      callback while the filter works on the period after it has returned,
+      so they cannot be handed over, and the filter processes must sleep on
+      something while waiting, so a lock-free ring would still need the
+      semaphore. Without copies, filtering is done within the callback,
+      see sync_callback_io.
+    */
+    if (bfconf->callback_io && !bfconf->blocking_io) {
+        int cb_module = -1;
+        glob.cb_single_thread = true;
+        FOR_IN_AND_OUT {
+            for (int n = 0; n < n_subdevs[IO]; n++) {
+                const int module = subdevs[IO][n].module;
+                if (cb_module == -1) {
+                    cb_module = module;
+                } else if (module != cb_module) {
+                    glob.cb_single_thread = false;
+                }
+            }
+        }
+    }
+
     /* allocate shared memory for interprocess communication */
     if ((ca = maybe_shmalloc(sizeof(struct comarea))) == NULL) {
         fprintf(stderr, "Failed to allocate shared memory.\n");
@@ -873,10 +1380,50 @@ dai_init(int _period_size,
             if (sd->uses_callback) {
                 sd->buf_left = 0;
                 sd->cb.frames_left = -1;
-                sd->cb.iodelay_fill = 2 * glob.period_size / sd->block_size_frames - 2;
+                sd->cb.iodelay_fill = callback_iodelay_fill(sd->block_size_frames);
             }
         }
 
+        /*
+          In synchronous mode with the server block the same as the
+          partition each callback is one full period, and unless the
+          channels need delay the filter processes can read and write the
+          server's buffers directly. This requires a single server thread
+          calling with all devices, and in fork mode they are not shared.
+        */
+        glob.cb_direct = bfconf->sync_callback_io && glob.cb_single_thread && !bf_is_fork_mode();
+        FOR_IN_AND_OUT {
+            for (int n = 0; n < glob.n_devs[IO] && glob.cb_direct; n++) {
+                struct subdev *sd = glob.dev[IO][n];
+                if (!sd->uses_callback) {
+                    continue;
+                }
+                if (sd->isinterleaved || sd->block_size_frames != glob.period_size) {
+                    glob.cb_direct = false;
+                    break;
+                }
+                for (int i = 0; i < sd->channels.used_channels; i++) {
+                    const int ch = sd->channels.channel_name[i];
+                    if (bfconf->n_virtperphys[IO][ch] != 1) {
+                        continue;
+                    }
+                    const int virtch = bfconf->phys2virt[IO][ch][0];
+                    if (bfconf->delay[IO][virtch] != 0 || bfconf->maxdelay[IO][virtch] >= 0 ||
+                        (bfconf->use_subdelay[IO] && bfconf->subdelay[IO][virtch] == BF_UNDEFINED_SUBDELAY))
+                    {
+                        glob.cb_direct = false;
+                        break;
+                    }
+                }
+            }
+        }
+        if (glob.cb_direct) {
+            /* read in place of muted inputs */
+            glob.cb_zerobuf = emallocaligned(glob.period_size * sizeof(double));
+            memset(glob.cb_zerobuf, 0, glob.period_size * sizeof(double));
+            pinfo("Callback I/O is done directly in the sound server's buffers.\n");
+        }
+
         // let callback_process() attach shared mem buffers (dummy action if not fork mode)
         uint8_t bool_msg = true;
         bf_sem_postmsg(&glob.cbpipe_s, &bool_msg, 1);
@@ -910,6 +1457,12 @@ Error: sound input hardware requires poll mode to be activated but current\n\
         glob.input_poll_mode = true;
         pinfo("Input poll mode activated\n");
     }
+    FOR_IN_AND_OUT {
+        glob.parallel_io[IO] = bfconf->parallel_io && glob.n_fd_devs[IO] > 1;
+    }
+    if (glob.parallel_io[IN] || glob.parallel_io[OUT]) {
+        pinfo("Blocking I/O devices are serviced in parallel threads.\n");
+    }
     return true;
 }
 
@@ -942,6 +1495,19 @@ dai_minblocksize(void)
     return size;
 }
 
+void *
+dai_callback_buffer(int io,
+                    int channel)
+{
+    return glob.cb_direct_buf[io][channel];
+}
+
+bool
+dai_callback_direct(void)
+{
+    return glob.cb_direct;
+}
+
 bool
 dai_input_poll_mode(void)
 {
@@ -1088,18 +1654,12 @@ dai_input(volatile struct debug_input dbg[],
 {
     static struct {
         bool isfirst;
-        bool startmeasure;
         int buf_index;
-        int frames;
         int curbuf;
-        struct timeval starttv;
     } st = {
         .isfirst = true,
-        .startmeasure = true,
         .buf_index = 0,
-        .frames = 0,
-        .curbuf = 0,
-        .starttv = {0}
+        .curbuf = 0
     };
 
     int dbg_pos = 0;
@@ -1119,6 +1679,10 @@ dai_input(volatile struct debug_input dbg[],
 
     if (st.isfirst) {
         ca->pid[IN] = bf_getpid();
+        iowait_init(IN);
+        if (glob.parallel_io[IN]) {
+            iothreads_init(IN);
+        }
 
         timestamp(&dbg[0].init.ts_start_call);
         dai_trigger_callback_io();
@@ -1141,21 +1705,41 @@ dai_input(volatile struct debug_input dbg[],
     st.curbuf = !st.curbuf;
 
     int devsleft = glob.n_fd_devs[IN];
-    fd_set rfds = glob.dev_fds[IN];
+    if (glob.parallel_io[IN]) {
+        iothreads_run(IN, buf);
+        for (int n = 0; n < glob.n_devs[IN]; n++) {
+            struct subdev *sd = glob.dev[IN][n];
+            if (sd->uses_callback) {
+                continue;
+            }
+            if (sd->iothread.eof_frames != -1) {
+                if (ca->frames_left == -1 || sd->iothread.eof_frames < ca->frames_left) {
+                    ca->frames_left = sd->iothread.eof_frames;
+                }
+                ca->lastbuf_index = st.buf_index;
+            } else if (glob.monitor_rate_fd == sd->fd) {
+                measure_rate(glob.period_size, true);
+            }
+        }
+        devsleft = 0;
+    }
+    for (int n = 0; n < glob.n_devs[IN] && devsleft != 0; n++) {
+        struct subdev *sd = glob.dev[IN][n];
+        if (!sd->uses_callback) {
+            sd->pending = true;
+            sd->ready = false;
+            iowait_arm(IN, sd);
+        }
+    }
     int minleft = glob.period_size;
     bool firstloop = true;
     while (devsleft != 0) {
-        fd_set readfds = rfds;
-        FD_SET(glob.paramspipe_s[IN][0], &readfds);
-
-        const int fdmax = (glob.dev_fdn[IN] > glob.paramspipe_s[IN][0]) ? glob.dev_fdn[IN] : glob.paramspipe_s[IN][0];
-
-        dbg[dbg_pos].select.fdmax = fdmax;
-        timestamp(&dbg[dbg_pos].select.ts_call);
-
-        struct timeval *ptv, zerotv_;
+        int64_t timeout_us = -1;
         if (glob.input_poll_mode) {
+            timeout_us = 0;
             if (!firstloop) {
+                /* sleep until the device with the least left to read
+                   should have a block ready */
                 int64_t usec = (int64_t)minleft * 1000000 / (int64_t)glob.sample_rate;
                 if (glob.min_block_size[IN] > 0) {
                     int64_t usec2 = (int64_t)glob.min_block_size[IN] * 1000000 / (int64_t)glob.sample_rate;
@@ -1163,63 +1747,38 @@ dai_input(volatile struct debug_input dbg[],
                         usec = usec2;
                     }
                 }
-                /* nanosleep sleeps precise in maximum 2 ms (Note 2025: statement applies
-                   to 2001 linux kernels, haven't checked current status) */
-                struct timespec ts;
-                if (usec > 40000) {
-                    ts.tv_sec = 0;
-                    ts.tv_nsec = usec * 1000;
-                    nanosleep(&ts, NULL);
-                } else if (usec > 20000) {
-                    ts.tv_sec = 0;
-                    ts.tv_nsec = 10000000;
-                    nanosleep(&ts, NULL);
-                } else if (usec > 2050) {
-                    ts.tv_sec = 0;
-                    ts.tv_nsec = 2000000;
-                    nanosleep(&ts, NULL);
-                } else if (usec > 50) {
-                    ts.tv_sec = 0;
-                    ts.tv_nsec = (usec - 50) * 1000;
-                    nanosleep(&ts, NULL);
+                if (usec > 50) {
+                    timeout_us = usec - 50;
                 }
             }
-            ptv = &zerotv_;
-            zerotv_ = (struct timeval){0};
-        } else {
-            ptv = NULL;
+        }
+        for (int n = 0; n < glob.n_devs[IN] && timeout_us != 0; n++) {
+            struct subdev *sd = glob.dev[IN][n];
+            if (!sd->uses_callback && sd->pending && !sd->pollable) {
+                timeout_us = 0;
+            }
         }
 
-        int fdn;
-        while ((fdn = select(fdmax + 1, &readfds, NULL, NULL, ptv)) == -1 && errno == EINTR);
+        dbg[dbg_pos].wait.timeout = (int)timeout_us;
+        timestamp(&dbg[dbg_pos].wait.ts_call);
 
-        timestamp(&dbg[dbg_pos].select.ts_ret);
-        dbg[dbg_pos].select.retval = fdn;
+        dbg[dbg_pos].wait.retval = iowait(IN, timeout_us);
 
-        if (fdn == -1) {
-            fprintf(stderr, "Select failed: %s.\n", strerror(errno));
-            bf_exit(BF_EXIT_OTHER);
-        }
+        timestamp(&dbg[dbg_pos].wait.ts_ret);
 
         for (int n = 0; n < glob.n_devs[IN]; n++) {
-            // if poll mode or bad alignment, always poll for data
             struct subdev *sd = glob.dev[IN][n];
-            if (sd->uses_clock && !sd->uses_callback && !FD_ISSET(sd->fd, &readfds) &&
-                (glob.input_poll_mode || sd->bad_alignment))
-            {
-                FD_SET(sd->fd, &readfds);
-                fdn++;
+            if (sd->uses_callback || !sd->pending) {
+                continue;
             }
-        }
-
-        int fd = -1;
-        while (fdn--) {
-            for (fd++; !FD_ISSET(fd, &readfds) && fd <= fdmax; fd++);
-            if (fd == glob.paramspipe_s[IN][0]) {
-                handle_params(IN);
+            // if poll mode or bad alignment, always poll for data
+            if (!sd->ready && sd->pollable &&
+                !(sd->uses_clock && (glob.input_poll_mode || sd->bad_alignment)))
+            {
                 continue;
             }
-            struct subdev *sd = glob.fd2dev[IN][fd];
+            sd->ready = false;
+            const int fd = sd->fd;
 
             dbg[dbg_pos].read.fd = fd;
             dbg[dbg_pos].read.buf = buf + sd->buf_offset;
@@ -1237,50 +1796,14 @@ dai_input(volatile struct debug_input dbg[],
             (*dbg_loops)++;
 
             switch (byte_count) {
-            case -1: {
-                switch (errno) {
-                case EINTR:
-                case EAGAIN:
-                    /* try again later */
-                    break;
-                case EIO:
-                    /* invalid input signal */
-                    fprintf(stderr, "I/O module failed to read due to invalid input signal, aborting.\n");
-                    bf_exit(BF_EXIT_INVALID_INPUT);
-                    break;
-                case EPIPE:
-                    /* buffer underflow */
-
-                    /* Actually, this should be overflow, but since we have
-                       linked the devices, broken pipe on output will be
-                       noted on the input as well, and it is more likely that
-                       it is an underflow on the output than an overflow on
-                       the input */
-                    fprintf(stderr, "I/O module failed to read (probably) due to buffer underflow on output, aborting.\n");
-                    bf_exit(BF_EXIT_BUFFER_UNDERFLOW);
-                    break;
-                default:
-                    /* general error */
-                    fprintf(stderr, "I/O module failed to read, aborting.\n");
-                    bf_exit(BF_EXIT_OTHER);
-                    break;
-                }
+            case -1:
+                read_error();
                 break;
-            }
             case 0: {
-                if (sd->isinterleaved) {
-                    memset(buf + sd->buf_offset + sd->buf_size - sd->buf_left, 0, sd->buf_left);
-                } else {
-                    const int i = sd->buf_size / sd->channels.open_channels;
-                    const int k = sd->buf_left / sd->channels.open_channels;
-                    for (int n = 1; n <= sd->channels.open_channels; n++) {
-                        memset(buf + sd->buf_offset + n * i - k, 0, k);
-                    }
-                }
                 devsleft--;
-                FD_CLR(fd, &rfds);
+                sd->pending = false;
 
-                const int frames_left = (sd->buf_size - sd->buf_left) / sd->channels.sf.bytes / sd->channels.open_channels;
+                const int frames_left = input_eof(sd, buf);
                 if (ca->frames_left == -1 || frames_left < ca->frames_left) {
                     ca->frames_left = frames_left;
                 }
@@ -1290,33 +1813,7 @@ dai_input(volatile struct debug_input dbg[],
             default: {
                 sd->buf_left -= byte_count;
                 if (glob.monitor_rate_fd == fd) {
-                    if (st.startmeasure) {
-                        if (sd->buf_left == 0) {
-                            st.startmeasure = false;
-                            gettimeofday(&st.starttv, NULL);
-                        }
-                    } else {
-                        st.frames += byte_count / (sd->buf_size / glob.period_size);
-                        if (st.frames >= glob.sample_rate && sd->buf_left == 0) {
-                            struct timeval tv;
-                            gettimeofday(&tv, NULL);
-                            timersub(&tv, &st.starttv, &tv);
-                            double measured_rate = 1000.0 * (double)st.frames / (double)(tv.tv_sec * 1000 + tv.tv_usec / 1000);
-                            if (bfconf->debug) {
-                                fprintf(stderr, "measured rate: %.3f kHz (%d frames / %ld usecs)\n",
-                                        measured_rate / 1000.0, st.frames, tv.tv_sec * 1000000 + tv.tv_usec);
-                            }
-                            if (measured_rate < (double)glob.sample_rate * 0.98 ||
-                                measured_rate > (double)glob.sample_rate / 0.98)
-                            {
-                                fprintf(stderr, "Configured sample rate is %.1f kHz, but measured is %.1f kHz, aborting.\n",
-                                        (double)glob.sample_rate / 1000.0, measured_rate / 1000.0);
-                                bf_exit(BF_EXIT_INVALID_INPUT);
-                            }
-                            st.startmeasure = true;
-                            st.frames = 0;
-                        }
-                    }
+                    measure_rate(byte_count / (sd->buf_size / glob.period_size), sd->buf_left == 0);
                 }
                 const int frames_left = sd->buf_left / (sd->buf_size / glob.period_size);
                 if (sd->uses_clock && (frames_left < minleft || minleft == -1)) {
@@ -1325,11 +1822,14 @@ dai_input(volatile struct debug_input dbg[],
                 if (sd->buf_left == 0) {
                     sd->buf_left = sd->buf_size;
                     devsleft--;
-                    FD_CLR(fd, &rfds);
+                    sd->pending = false;
                 }
                 break;
             }
             }
+            if (sd->pending) {
+                iowait_arm(IN, sd);
+            }
         }
         firstloop = false;
     }
@@ -1358,13 +1858,11 @@ dai_output(bool iodelay_fill,
         bool islast;
         int buf_index;
         int curbuf;
-        fd_set readfds;
     } st = {
         .isfirst = true,
         .islast = false,
         .buf_index = 0,
-        .curbuf = 0,
-        .readfds = {}
+        .curbuf = 0
     };
 
     int dbg_pos = 0;
@@ -1385,8 +1883,11 @@ dai_output(bool iodelay_fill,
         }
         st.islast = true;
     }
-    if (st.isfirst) {
-        FD_ZERO(&st.readfds); // in theory FD_ZERO() can be different from just = {}
+    if (glob.epoll_fd[OUT] == -1) {
+        iowait_init(OUT);
+        if (glob.parallel_io[OUT]) {
+            iothreads_init(OUT);
+        }
     }
 
     uint8_t *buf = (uint8_t *)glob.iobuffers[OUT][st.curbuf];
@@ -1400,42 +1901,49 @@ dai_output(bool iodelay_fill,
         update_delay(sd, OUT, buf);
     }
 
-    int devsleft;
-    fd_set wfds;
-    if (iodelay_fill) {
-        wfds = glob.clocked_wfds;
-        devsleft = glob.n_clocked_devs;
-    } else {
-        wfds = glob.dev_fds[OUT];
-        devsleft = glob.n_fd_devs[OUT];
+    /* the devices are started within the loop below, so the I/O delay and
+       the first period are not written in parallel */
+    const bool parallel = glob.parallel_io[OUT] && !iodelay_fill && !st.isfirst;
+    if (parallel) {
+        iothreads_run(OUT, buf);
     }
 
-    while (devsleft != 0) {
-        fd_set writefds = wfds;
-        FD_SET(glob.paramspipe_s[OUT][0], &st.readfds);
-        int fdn = (glob.dev_fdn[OUT] > glob.paramspipe_s[OUT][0]) ? glob.dev_fdn[OUT] : glob.paramspipe_s[OUT][0];
+    /* while filling the I/O delay only the clocked devices are written */
+    int devsleft = 0;
+    for (int n = 0; n < glob.n_devs[OUT] && !parallel; n++) {
+        struct subdev *sd = glob.dev[OUT][n];
+        sd->pending = !sd->uses_callback && (!iodelay_fill || sd->uses_clock);
+        if (sd->pending) {
+            devsleft++;
+            sd->ready = false;
+            iowait_arm(OUT, sd);
+        }
+    }
 
-        dbg[dbg_pos].select.fdmax = fdn + 1;
-        timestamp(&dbg[dbg_pos].select.ts_call);
+    while (devsleft != 0) {
+        int64_t timeout_us = -1;
+        for (int n = 0; n < glob.n_devs[OUT]; n++) {
+            struct subdev *sd = glob.dev[OUT][n];
+            if (sd->pending && !sd->pollable) {
+                timeout_us = 0;
+                break;
+            }
+        }
 
-        while ((fdn = select(fdn + 1, &st.readfds, &writefds, NULL, NULL)) == -1 && errno == EINTR);
+        dbg[dbg_pos].wait.timeout = (int)timeout_us;
+        timestamp(&dbg[dbg_pos].wait.ts_call);
 
-        timestamp(&dbg[dbg_pos].select.ts_ret);
-        dbg[dbg_pos].select.retval = fdn;
+        dbg[dbg_pos].wait.retval = iowait(OUT, timeout_us);
 
-        if (fdn == -1) {
-            fprintf(stderr, "Select failed: %s.\n", strerror(errno));
-            bf_exit(BF_EXIT_OTHER);
-        }
-        if (FD_ISSET(glob.paramspipe_s[OUT][0], &st.readfds)) {
-            handle_params(OUT);
-            fdn--;
-        }
+        timestamp(&dbg[dbg_pos].wait.ts_ret);
 
-        int fd = -1;
-        while (fdn--) {
-            for (fd++; !FD_ISSET(fd, &writefds) && fd <= glob.dev_fdn[OUT]; fd++);
-            struct subdev *sd = glob.fd2dev[OUT][fd];
+        for (int n = 0; n < glob.n_devs[OUT]; n++) {
+            struct subdev *sd = glob.dev[OUT][n];
+            if (!sd->pending || (!sd->ready && sd->pollable)) {
+                continue;
+            }
+            sd->ready = false;
+            const int fd = sd->fd;
             int write_size;
             if (sd->block_size > 0 && sd->buf_left > sd->block_size) {
                 write_size = sd->block_size + sd->buf_left % sd->block_size;
@@ -1461,22 +1969,7 @@ dai_output(bool iodelay_fill,
 
             switch (byte_count) {
             case -1:
-                switch (errno) {
-                case EINTR:
-                case EAGAIN:
-                    /* try again later */
-                    break;
-                case EPIPE:
-                    /* buffer underflow */
-                    fprintf(stderr, "I/O module failed to write due to buffer underflow, aborting.\n");
-                    bf_exit(BF_EXIT_BUFFER_UNDERFLOW);
-                    break;
-                default:
-                    /* general error */
-                    fprintf(stderr, "I/O module failed to write, aborting.\n");
-                    bf_exit(BF_EXIT_OTHER);
-                    break;
-                }
+                write_error();
                 break;
 
             default:
@@ -1486,7 +1979,9 @@ dai_output(bool iodelay_fill,
             if (sd->buf_left == 0) {
                 sd->buf_left = sd->buf_size;
                 devsleft--;
-                FD_CLR(fd, &wfds);
+                sd->pending = false;
+            } else {
+                iowait_arm(OUT, sd);
             }
         }
         if (synch_fd != NULL) {
@@ -1548,22 +2043,30 @@ dai_output(bool iodelay_fill,
     st.buf_index++;
 }
 
+static inline int
+callback_frames_left(const struct subdev *sd)
+{
+    return sd->buf_left / (sd->channels.used_channels * sd->channels.sf.bytes);
+}
+
 static void
 process_callback_input(struct subdev *sd,
                        void *cbbufs[],
+                       int frame_offset,
                        int frame_count)
 {
     uint8_t *buf = (uint8_t *)glob.iobuffers[IN][sd->cb.curbuf];
 
     const int count = frame_count * sd->channels.used_channels * sd->channels.sf.bytes;
     if (sd->isinterleaved) {
-        memcpy(buf + sd->buf_offset + sd->buf_size - sd->buf_left, cbbufs[0], count);
+        memcpy(buf + sd->buf_offset + sd->buf_size - sd->buf_left,
+               (uint8_t *)cbbufs[0] + frame_offset * sd->channels.used_channels * sd->channels.sf.bytes, count);
     } else {
         const struct buffer_format *bf = &dai_buffer_format[IN]->bf[sd->channels.channel_name[0]];
         const int cnt = count / sd->channels.used_channels;
         uint8_t *copybuf = buf + sd->buf_offset + (sd->buf_size - sd->buf_left) / sd->channels.used_channels;
         for (int n = 0; n < sd->channels.used_channels; n++) {
-            memcpy(copybuf, cbbufs[n], cnt);
+            memcpy(copybuf, (uint8_t *)cbbufs[n] + frame_offset * sd->channels.sf.bytes, cnt);
             copybuf += glob.period_size * bf->sf.sbytes;
         }
     }
@@ -1578,6 +2081,7 @@ process_callback_input(struct subdev *sd,
 static void
 process_callback_output(struct subdev *sd,
                         void *cbbufs[],
+                        int frame_offset,
                         int frame_count,
                         bool iodelay_fill)
 {
@@ -1587,11 +2091,11 @@ process_callback_output(struct subdev *sd,
 
     if (iodelay_fill) {
         if (sd->isinterleaved) {
-            memset(cbbufs[0], 0, count);
+            memset((uint8_t *)cbbufs[0] + frame_offset * sd->channels.used_channels * sd->channels.sf.bytes, 0, count);
         } else {
             const int cnt = count / sd->channels.used_channels;
             for (int n = 0; n < sd->channels.used_channels; n++) {
-                memset(cbbufs[n], 0, cnt);
+                memset((uint8_t *)cbbufs[n] + frame_offset * sd->channels.sf.bytes, 0, cnt);
             }
         }
         return;
@@ -1602,13 +2106,14 @@ process_callback_output(struct subdev *sd,
     }
     do_mute(sd, OUT, count, (void *)(buf + sd->buf_offset), sd->buf_size - sd->buf_left);
     if (sd->isinterleaved) {
-        memcpy(cbbufs[0], buf + sd->buf_offset + sd->buf_size - sd->buf_left, count);
+        memcpy((uint8_t *)cbbufs[0] + frame_offset * sd->channels.used_channels * sd->channels.sf.bytes,
+               buf + sd->buf_offset + sd->buf_size - sd->buf_left, count);
     } else {
         const struct buffer_format *bf = &dai_buffer_format[OUT]->bf[sd->channels.channel_name[0]];
         const int cnt = count / sd->channels.used_channels;
         const uint8_t *copybuf = buf + sd->buf_offset + (sd->buf_size - sd->buf_left) / sd->channels.used_channels;
         for (int n = 0; n < sd->channels.used_channels; n++) {
-            memcpy(cbbufs[n], copybuf, cnt);
+            memcpy((uint8_t *)cbbufs[n] + frame_offset * sd->channels.sf.bytes, copybuf, cnt);
             copybuf += glob.period_size * bf->sf.sbytes;
         }
     }
@@ -1637,6 +2142,79 @@ wait_callback_ready(int io)
     bf_sem_wait(&glob.cbreadywait_pipe[io]);
 }
 
+static void
+process_callback_direct(void **states[2],
+                        int state_count[2],
+                        void **buffers[2],
+                        int frame_count)
+{
+    FOR_IN_AND_OUT {
+        for (int n = 0, i = 0; n < state_count[IO]; n++) {
+            struct subdev *sd = (struct subdev *)states[IO][n];
+            if (frame_count != sd->block_size_frames) {
+                fprintf(stderr, "Error: unexpected callback I/O block size (got %d, expected %d)\n",
+                        frame_count, sd->block_size_frames);
+                bf_exit(BF_EXIT_OTHER);
+            }
+            for (int j = 0; j < sd->channels.used_channels; j++, i++) {
+                const int ch = sd->channels.channel_name[j];
+                if (IO == IN && ca->is_muted[IN][ch]) {
+                    glob.cb_direct_buf[IN][ch] = glob.cb_zerobuf;
+                } else {
+                    glob.cb_direct_buf[IO][ch] = buffers[IO][i];
+                }
+            }
+        }
+    }
+
+    /* trigger the filter processes and wait for them to finish the period */
+    if (state_count[IN] > 0) {
+        bf_callback_ready(IN);
+        ca->cb_buf_index[IN]++;
+    }
+    if (state_count[OUT] > 0) {
+        bf_callback_ready(OUT);
+        ca->cb_buf_index[OUT]++;
+        for (int n = 0, i = 0; n < state_count[OUT]; n++) {
+            struct subdev *sd = (struct subdev *)states[OUT][n];
+            for (int j = 0; j < sd->channels.used_channels; j++, i++) {
+                if (ca->is_muted[OUT][sd->channels.channel_name[j]]) {
+                    memset(buffers[OUT][i], 0, frame_count * sd->channels.sf.bytes);
+                }
+            }
+        }
+    }
+}
+
+static int
+callback_last_buffer(struct subdev *sd)
+{
+    const int buf_index = ca->cb_buf_index[IN] < ca->cb_buf_index[OUT] ? ca->cb_buf_index[OUT] : ca->cb_buf_index[IN];
+    if (sd->cb.frames_left == -1 &&
+        ((ca->frames_left != -1 && buf_index == ca->lastbuf_index + 1) ||
+         (ca->cb_frames_left != -1 && buf_index == ca->cb_lastbuf_index + 1)))
+    {
+        if (ca->frames_left == -1 ||
+            (ca->frames_left > ca->cb_frames_left && ca->cb_frames_left != -1))
+        {
+            ca->frames_left = ca->cb_frames_left;
+        }
+        sd->cb.frames_left = ca->frames_left;
+    }
+
+    if (sd->cb.frames_left != -1) {
+        if (sd->cb.frames_left > sd->block_size_frames) {
+            sd->cb.frames_left -= sd->block_size_frames;
+            return 0;
+        }
+        if (sd->cb.frames_left == 0) {
+            return -1;
+        }
+        return sd->cb.frames_left;
+    }
+    return 0;
+}
+
 static int
 process_callback(void **states[2],
                  int state_count[2],
@@ -1682,26 +2260,45 @@ process_callback(void **states[2],
         bf_exit(BF_EXIT_OTHER);
     }
 
-    if (state_count[IN] > 0) {
+    if (glob.cb_direct) {
+        process_callback_direct(states, state_count, buffers, frame_count);
+        return state_count[OUT] > 0 ? callback_last_buffer((struct subdev *)states[OUT][0]) : 0;
+    }
+
+    /*
+      The server block need not be aligned with the partition, so each
+      block is copied in parts split at period boundaries, and the filter
+      handoff is made at the boundary, wherever it falls within the block.
+    */
+    for (int n = 0; n < state_count[IN]; n++) {
+        struct subdev *sd = (struct subdev *)states[IN][n];
+        if (frame_count != sd->block_size_frames) {
+            fprintf(stderr, "Error: unexpected callback I/O block size (got %d, expected %d)\n",
+                    frame_count, sd->block_size_frames);
+            bf_exit(BF_EXIT_OTHER);
+        }
+    }
+    for (int frame_offset = 0; state_count[IN] > 0 && frame_offset < frame_count; ) {
 
         cbmutex(IN, true);
 
+        struct subdev *sd = (struct subdev *)states[IN][0];
+        int frames = callback_frames_left(sd);
+        if (frames > frame_count - frame_offset) {
+            frames = frame_count - frame_offset;
+        }
         for (int n = 0, i = 0; n < state_count[IN]; n++) {
-            struct subdev *sd = (struct subdev *)states[IN][n];
-            if (frame_count != sd->block_size_frames) {
-                fprintf(stderr, "Error: unexpected callback I/O block alignment (got %d, expected %d)\n",
-                        frame_count, sd->block_size_frames);
-                bf_exit(BF_EXIT_OTHER);
-            }
-            process_callback_input(sd, &buffers[IN][i], frame_count);
+            sd = (struct subdev *)states[IN][n];
+            process_callback_input(sd, &buffers[IN][i], frame_offset, frames);
             if (sd->isinterleaved) {
                 i++;
             } else {
                 i += sd->channels.used_channels;
             }
         }
+        frame_offset += frames;
 
-        struct subdev *sd = (struct subdev *)states[IN][0];
+        sd = (struct subdev *)states[IN][0];
         if (sd->buf_left == 0) {
             bool finished = true;
             for (int n = 0; n < glob.n_devs[IN]; n++) {
@@ -1732,86 +2329,75 @@ process_callback(void **states[2],
     if (state_count[OUT] > 0) {
         struct subdev *sd;
 
-        cbmutex(OUT, true);
-
-        bool unlock_output = false;
-        sd = (struct subdev *)states[OUT][0];
-        if (sd->buf_left == 0 && sd->cb.iodelay_fill == 0) {
-            bool finished = true;
-            for (int n = 0; n < glob.n_devs[OUT]; n++) {
-                sd = glob.dev[OUT][n];
-                if (sd->uses_callback &&
-                    (sd->buf_left != 0 || sd->cb.iodelay_fill != 0))
-                {
-                    finished = false;
-                    break;
-                }
-            }
-            if (finished) {
-                for (int n = 0; n < glob.n_devs[OUT]; n++) {
-                    sd = glob.dev[OUT][n];
-                    if (sd->uses_callback) {
-                        sd->buf_left = sd->buf_size;
-                    }
-                }
-                bf_callback_ready(OUT);
-                ca->cb_buf_index[OUT]++;
-                trigger_callback_ready(OUT);
-            } else {
-                wait_callback_ready(OUT);
-            }
-        } else {
-            unlock_output = true;
-        }
-
-        for (int n = 0, i = 0; n < state_count[OUT]; n++) {
+        for (int n = 0; n < state_count[OUT]; n++) {
             sd = (struct subdev *)states[OUT][n];
             if (frame_count != sd->block_size_frames) {
-                fprintf(stderr, "Error: unexpected callback I/O block alignment (%d != %d)\n",
+                fprintf(stderr, "Error: unexpected callback I/O block size (got %d, expected %d)\n",
                         frame_count, sd->block_size_frames);
                 bf_exit(BF_EXIT_OTHER);
             }
-            process_callback_output(sd, &buffers[OUT][i], frame_count, sd->cb.iodelay_fill != 0);
-            if (sd->cb.iodelay_fill != 0) {
-                sd->cb.iodelay_fill--;
-            }
-            if (sd->isinterleaved) {
-                i++;
-            } else {
-                i += sd->channels.used_channels;
-            }
         }
 
-        if (unlock_output) {
-            cbmutex(OUT, false);
-        }
+        for (int frame_offset = 0; frame_offset < frame_count; ) {
 
-        /* last buffer? */
-        const int buf_index = ca->cb_buf_index[IN] < ca->cb_buf_index[OUT] ? ca->cb_buf_index[OUT] : ca->cb_buf_index[IN];
-        sd = (struct subdev *)states[OUT][0];
-        if (sd->cb.frames_left == -1 &&
-            ((ca->frames_left != -1 && buf_index == ca->lastbuf_index + 1) ||
-             (ca->cb_frames_left != -1 && buf_index == ca->cb_lastbuf_index + 1)))
-        {
-            if (ca->frames_left == -1 ||
-                (ca->frames_left > ca->cb_frames_left && ca->cb_frames_left != -1))
-            {
-                ca->frames_left = ca->cb_frames_left;
+            cbmutex(OUT, true);
+
+            bool unlock_output = false;
+            sd = (struct subdev *)states[OUT][0];
+            if (sd->buf_left == 0 && sd->cb.iodelay_fill == 0) {
+                bool finished = true;
+                for (int n = 0; n < glob.n_devs[OUT]; n++) {
+                    sd = glob.dev[OUT][n];
+                    if (sd->uses_callback &&
+                        (sd->buf_left != 0 || sd->cb.iodelay_fill != 0))
+                    {
+                        finished = false;
+                        break;
+                    }
+                }
+                if (finished) {
+                    for (int n = 0; n < glob.n_devs[OUT]; n++) {
+                        sd = glob.dev[OUT][n];
+                        if (sd->uses_callback) {
+                            sd->buf_left = sd->buf_size;
+                        }
+                    }
+                    bf_callback_ready(OUT);
+                    ca->cb_buf_index[OUT]++;
+                    trigger_callback_ready(OUT);
+                } else {
+                    wait_callback_ready(OUT);
+                }
+            } else {
+                unlock_output = true;
             }
-            sd->cb.frames_left = ca->frames_left;
-        }
 
-        if (sd->cb.frames_left != -1) {
-            if (sd->cb.frames_left > sd->block_size_frames) {
-                sd->cb.frames_left -= sd->block_size_frames;
-                return 0;
+            sd = (struct subdev *)states[OUT][0];
+            int frames = sd->cb.iodelay_fill != 0 ? sd->cb.iodelay_fill : callback_frames_left(sd);
+            if (frames > frame_count - frame_offset) {
+                frames = frame_count - frame_offset;
             }
-            if (sd->cb.frames_left == 0) {
-                return -1;
+            for (int n = 0, i = 0; n < state_count[OUT]; n++) {
+                sd = (struct subdev *)states[OUT][n];
+                process_callback_output(sd, &buffers[OUT][i], frame_offset, frames, sd->cb.iodelay_fill != 0);
+                if (sd->cb.iodelay_fill != 0) {
+                    sd->cb.iodelay_fill -= frames;
+                }
+                if (sd->isinterleaved) {
+                    i++;
+                } else {
+                    i += sd->channels.used_channels;
+                }
+            }
+            frame_offset += frames;
+
+            if (unlock_output) {
+                cbmutex(OUT, false);
             }
-            return sd->cb.frames_left;
         }
 
+        /* last buffer? */
+        return callback_last_buffer((struct subdev *)states[OUT][0]);
     }
 
     return 0;
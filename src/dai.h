@@ -74,11 +74,11 @@ struct debug_input {
         uint64_t ts_start_ret;
     } init;
     struct {
-        int fdmax;
+        int timeout; /* in microseconds, -1 is forever */
         int retval;
         uint64_t ts_call;
         uint64_t ts_ret;
-    } select;
+    } wait;
     struct {
         int fd;
         void *buf;
@@ -98,11 +98,11 @@ struct debug_output {
         uint64_t ts_start_ret;
     } init;
     struct {
-        int fdmax;
+        int timeout; /* in microseconds, -1 is forever */
         int retval;
         uint64_t ts_call;
         uint64_t ts_ret;
-    } select;
+    } wait;
     struct {
         int fd;
         void *buf;
@@ -150,6 +150,19 @@ dai_trigger_callback_io(void);
 int
 dai_minblocksize(void);
 
+/*
+ * True if callback I/O is done synchronously directly in the sound server's
+ * buffers, which then are given per period by dai_callback_buffer(). A
+ * buffer is valid from the filter process is triggered until it signals
+ * that the period is done.
+ */
+bool
+dai_callback_direct(void);
+
+void *
+dai_callback_buffer(int io,
+                    int channel);
+
 bool
 dai_input_poll_mode(void);
 
@@ -9,6 +9,10 @@
 #include <string.h>
 #include <inttypes.h>
 #include <math.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "pinfo.h"
 #include "delay.h"
@@ -25,20 +29,18 @@ static td_conv_t **subdelay_filter = NULL;
 static int subdelay_step_count;
 static int subdelay_filterblock_size;
 static int subdelay_fragment_size;
+static double subdelay_kaiser_beta;
 
 struct delaybuffer_t_ {
     int fragsize;    /* fragment size */
     int maxdelay;    /* maximum allowable delay, or negative if delay cannot be
                         changed in runtime */
     int curdelay;    /* current delay */
-    int curbuf;      /* index of current full-sized buffer */
-    int n_fbufs;     /* number of full-sized buffers currently used */
-    int n_fbufs_cap; /* number of full-sized buffers allocated */
-    void **fbufs;    /* full-sized buffers */
-    int n_rest;      /* samples in rest buffer */
-    void *rbuf;      /* rest buffer */
-    void *shortbuf[2]; /* pointers to buffers which fit the whole delay, only
-                          used when delay is <= fragment size */
+    int n_ring;      /* ring size in samples, at least fragsize + max delay */
+    int wpos;        /* write position in ring, in samples */
+    bool mirrored;   /* ring is mapped twice back to back, so any span of up
+                        to n_ring samples starting in the ring is contiguous */
+    uint8_t *ring;   /* ring buffer */
 };
 
 static double
@@ -87,33 +89,54 @@ copy_to_delaybuf(void *dbuf,
         return;
     }
 
+    n = i = 0;
     switch (sample_size) {
     case 1:
-        for (n = i = 0; n < n_samples; n++, i += sample_spacing) {
+        for (; n < n_samples; n++, i += sample_spacing) {
             ((uint8_t *)dbuf)[n] = ((uint8_t *)buf)[i];
         }
         break;
     case 2:
-        for (n = i = 0; n < n_samples; n++, i += sample_spacing) {
+#ifdef __SSE2__
+        for (; n < n_samples - 7; n += 8, i += 8 * sample_spacing) {
+            const uint16_t *s = &((uint16_t *)buf)[i];
+            const int sp = sample_spacing;
+            _mm_storeu_si128((__m128i *)&((uint16_t *)dbuf)[n],
+                             _mm_setr_epi16(s[0], s[sp], s[2*sp], s[3*sp],
+                                            s[4*sp], s[5*sp], s[6*sp],
+                                            s[7*sp]));
+        }
+#endif
+        for (; n < n_samples; n++, i += sample_spacing) {
             ((uint16_t *)dbuf)[n] = ((uint16_t *)buf)[i];
         }
         break;
     case 3:
-        n_samples *= 3;
-        sample_spacing = sample_spacing * 3 - 3;
-        for (n = i = 0; n < n_samples; i += sample_spacing) {
-            ((uint8_t *)dbuf)[n++] = ((uint8_t *)buf)[i++];
-            ((uint8_t *)dbuf)[n++] = ((uint8_t *)buf)[i++];
-            ((uint8_t *)dbuf)[n++] = ((uint8_t *)buf)[i++];
+        /* move four bytes at a time, the extra byte is overwritten by the
+           next sample, except for the last which is moved exactly */
+        sample_spacing *= 3;
+        for (; n < n_samples - 1; n++, i += sample_spacing) {
+            memcpy(&((uint8_t *)dbuf)[3 * n], &((uint8_t *)buf)[i], 4);
+        }
+        if (n < n_samples) {
+            memcpy(&((uint8_t *)dbuf)[3 * n], &((uint8_t *)buf)[i], 3);
         }
         break;
     case 4:
-        for (n = i = 0; n < n_samples; n++, i += sample_spacing) {
+#ifdef __SSE2__
+        for (; n < n_samples - 3; n += 4, i += 4 * sample_spacing) {
+            const int32_t *s = &((int32_t *)buf)[i];
+            const int sp = sample_spacing;
+            _mm_storeu_si128((__m128i *)&((int32_t *)dbuf)[n],
+                             _mm_setr_epi32(s[0], s[sp], s[2*sp], s[3*sp]));
+        }
+#endif
+        for (; n < n_samples; n++, i += sample_spacing) {
             ((uint32_t *)dbuf)[n] = ((uint32_t *)buf)[i];
         }
         break;
     case 8:
-        for (n = i = 0; n < n_samples; n++, i += sample_spacing) {
+        for (; n < n_samples; n++, i += sample_spacing) {
             ((uint64_t *)dbuf)[n] = ((uint64_t *)buf)[i];
         }
         break;
@@ -138,33 +161,60 @@ copy_from_delaybuf(void *buf,
         return;
     }
 
+    n = i = 0;
     switch (sample_size) {
     case 1:
-        for (n = i = 0; n < n_samples; n++, i += sample_spacing) {
+        for (; n < n_samples; n++, i += sample_spacing) {
             ((uint8_t *)buf)[i] = ((uint8_t *)dbuf)[n];
         }
         break;
     case 2:
-        for (n = i = 0; n < n_samples; n++, i += sample_spacing) {
+#ifdef __SSE2__
+        for (; n < n_samples - 7; n += 8, i += 8 * sample_spacing) {
+            uint16_t *d = &((uint16_t *)buf)[i];
+            const int sp = sample_spacing;
+            const __m128i x =
+                _mm_loadu_si128((__m128i *)&((uint16_t *)dbuf)[n]);
+            d[0] = (uint16_t)_mm_extract_epi16(x, 0);
+            d[sp] = (uint16_t)_mm_extract_epi16(x, 1);
+            d[2*sp] = (uint16_t)_mm_extract_epi16(x, 2);
+            d[3*sp] = (uint16_t)_mm_extract_epi16(x, 3);
+            d[4*sp] = (uint16_t)_mm_extract_epi16(x, 4);
+            d[5*sp] = (uint16_t)_mm_extract_epi16(x, 5);
+            d[6*sp] = (uint16_t)_mm_extract_epi16(x, 6);
+            d[7*sp] = (uint16_t)_mm_extract_epi16(x, 7);
+        }
+#endif
+        for (; n < n_samples; n++, i += sample_spacing) {
             ((uint16_t *)buf)[i] = ((uint16_t *)dbuf)[n];
         }
         break;
     case 3:
-        n_samples *= 3;
-        sample_spacing = sample_spacing * 3 - 3;
-        for (n = i = 0; n < n_samples; i += sample_spacing) {
-            ((uint8_t *)buf)[i++] = ((uint8_t *)dbuf)[n++];
-            ((uint8_t *)buf)[i++] = ((uint8_t *)dbuf)[n++];
-            ((uint8_t *)buf)[i++] = ((uint8_t *)dbuf)[n++];
+        /* exactly three bytes, the next byte belongs to another channel */
+        sample_spacing *= 3;
+        for (; n < n_samples; n++, i += sample_spacing) {
+            memcpy(&((uint8_t *)buf)[i], &((uint8_t *)dbuf)[3 * n], 3);
         }
         break;
     case 4:
-        for (n = i = 0; n < n_samples; n++, i += sample_spacing) {
+#ifdef __SSE2__
+        for (; n < n_samples - 3; n += 4, i += 4 * sample_spacing) {
+            int32_t *d = &((int32_t *)buf)[i];
+            const int sp = sample_spacing;
+            const __m128i x =
+                _mm_loadu_si128((__m128i *)&((int32_t *)dbuf)[n]);
+            d[0] = _mm_cvtsi128_si32(x);
+            d[sp] = _mm_cvtsi128_si32(_mm_srli_si128(x, 4));
+            d[2*sp] = _mm_cvtsi128_si32(_mm_srli_si128(x, 8));
+            d[3*sp] = _mm_cvtsi128_si32(_mm_srli_si128(x, 12));
+        }
+#endif
+        for (; n < n_samples; n++, i += sample_spacing) {
             ((uint32_t *)buf)[i] = ((uint32_t *)dbuf)[n];
         }
         break;
     case 8:
-        for (n = i = 0; n < n_samples; n++, i += sample_spacing) {
+        for (; n < n_samples; n++, i += sample_spacing) {
             ((uint64_t *)buf)[i] = ((uint64_t *)dbuf)[n];
         }
         break;
@@ -175,104 +225,53 @@ copy_from_delaybuf(void *buf,
     }
 }
 
-static void
-shift_samples(void *buf,
-              int sample_size,
-              int sample_spacing,
-              int n_samples,
-              int distance)
+/* number of samples which can be accessed contiguously from ring position
+   'pos', the rest continues at the start of the ring */
+static inline int
+ring_span(delaybuffer_t *db,
+          int pos,
+          int n_samples)
 {
-    int n, i;
-
-    n = (n_samples - 1) * sample_spacing;
-    i = (n_samples + distance - 1) * sample_spacing;
-    switch (sample_size) {
-    case 1:
-        for (; n >= 0; n -= sample_spacing, i -= sample_spacing) {
-            ((uint8_t *)buf)[i] = ((uint8_t *)buf)[n];
-        }
-        break;
-    case 2:
-        for (; n >= 0; n -= sample_spacing, i -= sample_spacing) {
-            ((uint16_t *)buf)[i] = ((uint16_t *)buf)[n];
-        }
-        break;
-    case 3:
-        for (; n >= 0; n -= sample_spacing, i -= sample_spacing) {
-            ((uint8_t *)buf)[i * 3 + 0] = ((uint8_t *)buf)[n * 3 + 0];
-            ((uint8_t *)buf)[i * 3 + 1] = ((uint8_t *)buf)[n * 3 + 1];
-            ((uint8_t *)buf)[i * 3 + 2] = ((uint8_t *)buf)[n * 3 + 2];
-        }
-        break;
-    case 4:
-        for (; n >= 0; n -= sample_spacing, i -= sample_spacing) {
-            ((uint32_t *)buf)[i] = ((uint32_t *)buf)[n];
-        }
-        break;
-    case 8:
-        for (; n >= 0; n -= sample_spacing, i -= sample_spacing) {
-            ((uint64_t *)buf)[i] = ((uint64_t *)buf)[n];
-        }
-        break;
-    default:
-        fprintf(stderr, "Sample byte size %d not supported.\n", sample_size);
-        bf_exit(BF_EXIT_OTHER);
-        break;
+    if (db->mirrored || pos + n_samples <= db->n_ring) {
+        return n_samples;
     }
+    return db->n_ring - pos;
 }
 
 static void
-update_delay_buffer(delaybuffer_t *db,
-                    int sample_size,
-                    int sample_spacing,
-                    uint8_t *buf)
+ring_write(delaybuffer_t *db,
+           int pos,
+           uint8_t *buf,
+           int sample_size,
+           int sample_spacing,
+           int n_samples)
 {
-    uint8_t *lastbuf;
-
-    lastbuf = (db->curbuf == db->n_fbufs - 1) ? db->fbufs[0] :
-        db->fbufs[db->curbuf + 1];
+    int n = ring_span(db, pos, n_samples);
 
-    /* 1. copy buffer to current full-sized delay buffer */
-    copy_to_delaybuf(db->fbufs[db->curbuf], buf, sample_size,
-                     sample_spacing, db->fragsize);
-
-    if (db->n_rest != 0) {
-        /* 2. copy from delay rest buffer to the start of buffer */
-        copy_from_delaybuf(buf, db->rbuf, sample_size, sample_spacing,
-                           db->n_rest);
-
-        /* 3. copy from end of last full-sized delay buffer to rest buffer */
-        memcpy(db->rbuf, lastbuf + (db->fragsize - db->n_rest) * sample_size,
-               db->n_rest * sample_size);
-    }
-
-    /* 4. copy from start of last full-sized buffer to end of buffer */
-    copy_from_delaybuf(buf + db->n_rest * sample_size * sample_spacing,
-                       lastbuf, sample_size, sample_spacing,
-                       db->fragsize - db->n_rest);
-
-    if (++db->curbuf == db->n_fbufs) {
-        db->curbuf = 0;
+    copy_to_delaybuf(&db->ring[pos * sample_size], buf, sample_size,
+                     sample_spacing, n);
+    if (n < n_samples) {
+        copy_to_delaybuf(db->ring, buf + n * sample_size * sample_spacing,
+                         sample_size, sample_spacing, n_samples - n);
     }
 }
 
 static void
-update_delay_short_buffer(delaybuffer_t *db,
-                          int sample_size,
-                          int sample_spacing,
-                          uint8_t *buf)
+ring_read(delaybuffer_t *db,
+          int pos,
+          uint8_t *buf,
+          int sample_size,
+          int sample_spacing,
+          int n_samples)
 {
-    copy_to_delaybuf(db->shortbuf[db->curbuf],
-                     buf + (db->fragsize - db->n_rest) * sample_size *
-                     sample_spacing, sample_size, sample_spacing,
-                     db->n_rest);
-
-    shift_samples(buf, sample_size, sample_spacing,
-                  db->fragsize - db->n_rest, db->n_rest);
+    int n = ring_span(db, pos, n_samples);
 
-    db->curbuf = !db->curbuf;
-    copy_from_delaybuf(buf, db->shortbuf[db->curbuf], sample_size,
-                       sample_spacing, db->n_rest);
+    copy_from_delaybuf(buf, &db->ring[pos * sample_size], sample_size,
+                       sample_spacing, n);
+    if (n < n_samples) {
+        copy_from_delaybuf(buf + n * sample_size * sample_spacing, db->ring,
+                           sample_size, sample_spacing, n_samples - n);
+    }
 }
 
 static void
@@ -280,35 +279,26 @@ change_delay(delaybuffer_t *db,
              int sample_size,
              int newdelay)
 {
-    int size, i;
+    int pos, n, n_zero;
 
     if (newdelay == db->curdelay || newdelay > db->maxdelay) {
         return;
     }
-    if (newdelay <= db->fragsize) {
-        db->n_rest = newdelay;
-        size = newdelay * sample_size;
-        if (db->curdelay > db->fragsize || db->curdelay < newdelay) {
-            memset(db->shortbuf[0], 0, size);
-            memset(db->shortbuf[1], 0, size);
-        }
-        db->n_fbufs = 0;
-        db->curbuf = 0;
-        db->curdelay = newdelay;
-        return;
-    }
-    db->n_rest = newdelay % db->fragsize;
-    db->n_fbufs = newdelay / db->fragsize + 1;
-    size = db->fragsize * sample_size;
-    if (db->curdelay < newdelay) {
-        for (i = 0; i < db->n_fbufs; i++) {
-            memset(db->fbufs[i], 0, size);
+    if (newdelay > db->curdelay) {
+        /* the samples between the new and the old read position have
+           already been played (or never been written), so they are replaced
+           with silence */
+        n_zero = newdelay - db->curdelay;
+        pos = db->wpos - newdelay;
+        if (pos < 0) {
+            pos += db->n_ring;
         }
-        if (db->n_rest != 0) {
-            memset(db->rbuf, 0, db->n_rest * sample_size);
+        n = ring_span(db, pos, n_zero);
+        memset(&db->ring[pos * sample_size], 0, n * sample_size);
+        if (n < n_zero) {
+            memset(db->ring, 0, (n_zero - n) * sample_size);
         }
     }
-    db->curbuf = 0;
     db->curdelay = newdelay;
 }
 
@@ -320,17 +310,32 @@ delay_update(delaybuffer_t *db,
              int delay,
              void *optional_target_buf)
 {
+    int rpos;
+
     change_delay(db, sample_size, delay);
+    if (db->curdelay == 0) {
+        if (optional_target_buf != NULL) {
+            copy_to_delaybuf(optional_target_buf, buf, sample_size,
+                             sample_spacing, db->fragsize);
+        }
+        return;
+    }
+
+    /* write the new fragment first, then read the delayed one, which may
+       overlap the newly written samples if the delay is shorter than a
+       fragment */
+    ring_write(db, db->wpos, buf, sample_size, sample_spacing, db->fragsize);
+    rpos = db->wpos - db->curdelay;
+    if (rpos < 0) {
+        rpos += db->n_ring;
+    }
     if (optional_target_buf != NULL) {
-        copy_to_delaybuf(optional_target_buf, buf, sample_size, sample_spacing,
-                         db->fragsize);
         buf = optional_target_buf;
         sample_spacing = 1;
     }
-    if (db->n_fbufs > 0) {
-        update_delay_buffer(db, sample_size, sample_spacing, buf);
-    } else if (db->n_rest > 0) {
-        update_delay_short_buffer(db, sample_size, sample_spacing, buf);
+    ring_read(db, rpos, buf, sample_size, sample_spacing, db->fragsize);
+    if ((db->wpos += db->fragsize) >= db->n_ring) {
+        db->wpos -= db->n_ring;
     }
 }
 
@@ -341,8 +346,7 @@ delay_allocate_buffer(int fragment_size,
                       int sample_size)
 {
     delaybuffer_t *db;
-    int n, delay;
-    int size;
+    int delay, pagesize;
 
     /* if maxdelay is negative, no delay changing will be allowed, thus
        memory need only to be allocated for the current delay */
@@ -359,45 +363,24 @@ delay_allocate_buffer(int fragment_size,
     if (delay == 0) {
         return db;
     }
-    if (delay <= fragment_size) {
-        /* optimise for short delay */
-        db->n_rest = initdelay; /* current value */
-        size = delay * sample_size;
-        db->shortbuf[0] = emallocaligned(size);
-        db->shortbuf[1] = emallocaligned(size);
-        memset(db->shortbuf[0], 0, size);
-        memset(db->shortbuf[1], 0, size);
-        return db;
-    }
-    if (maxdelay > 0) {
-        /* allocate full-length short buffers to keep this option if the
-           delay is reduced in run-time */
-        size = fragment_size * sample_size;
-        db->shortbuf[0] = emallocaligned(size);
-        db->shortbuf[1] = emallocaligned(size);
-        memset(db->shortbuf[0], 0, size);
-        memset(db->shortbuf[1], 0, size);
-    }
 
-    db->n_rest = initdelay % fragment_size;
-    db->n_fbufs = initdelay / fragment_size + 1;
-    if (db->n_fbufs == 1) {
-        db->n_fbufs = 0;
-    }
-    db->n_fbufs_cap = delay / fragment_size + 1;
-    db->fbufs = emalloc(db->n_fbufs_cap * sizeof(void *));
-    size = fragment_size * sample_size;
-    for (n = 0; n < db->n_fbufs_cap; n++) {
-        db->fbufs[n] = emallocaligned(size);
-        memset(db->fbufs[n], 0, size);
+    /* a single ring holding at least one fragment plus the delay. If it can
+       be mapped twice back to back any delayed fragment is one contiguous
+       span, otherwise reads and writes are split where the ring wraps. The
+       ring length is a multiple of the page size in samples, which makes it
+       a multiple of the page size in bytes for any sample size */
+    db->n_ring = fragment_size + delay;
+    pagesize = (int)sysconf(_SC_PAGESIZE);
+    if (pagesize > 0) {
+        db->n_ring = (db->n_ring + pagesize - 1) / pagesize * pagesize;
+        db->ring = allocate_mirrored_memory((size_t)db->n_ring * sample_size);
     }
-    if (maxdelay > 0) {
-        db->rbuf = emallocaligned(size);
-        memset(db->rbuf, 0, size);
-    } else if (db->n_rest != 0) {
-        size = db->n_rest * sample_size;
-        db->rbuf = emallocaligned(size);
-        memset(db->rbuf, 0, size);
+    if (db->ring != NULL) {
+        db->mirrored = true;
+    } else {
+        db->n_ring = fragment_size + delay;
+        db->ring = emallocaligned((size_t)db->n_ring * sample_size);
+        memset(db->ring, 0, (size_t)db->n_ring * sample_size);
     }
     return db;
 }
@@ -437,6 +420,31 @@ delay_subsample_update(void *buf,
     /*fprintf(stderr, "%" PRIu64 "\n", t2 / (uint64_t)bfconf->cpu_mhz);*/
 }
 
+void *
+delay_subsample_filter(int subdelay,
+                       int *n_taps)
+{
+    void *filter;
+
+    if (subdelay <= -subdelay_step_count || subdelay >= subdelay_step_count) {
+        return NULL;
+    }
+    *n_taps = subdelay_filter_length;
+    if (subdelay != 0) {
+        return sample_sinc(subdelay_filter_length >> 1,
+                           (double)subdelay / subdelay_step_count,
+                           subdelay_kaiser_beta);
+    }
+    filter = emallocaligned(subdelay_filter_length * realsize);
+    memset(filter, 0, subdelay_filter_length * realsize);
+    if (realsize == 4) {
+        ((float *)filter)[subdelay_filter_length >> 1] = 1.0;
+    } else {
+        ((double *)filter)[subdelay_filter_length >> 1] = 1.0;
+    }
+    return filter;
+}
+
 bool
 delay_subsample_init(int step_count,
                      int half_filter_length,
@@ -470,6 +478,7 @@ delay_subsample_init(int step_count,
     }
     subdelay_fragment_size = fragment_size;
     subdelay_step_count = step_count;
+    subdelay_kaiser_beta = kaiser_beta;
     subdelay_filter = emalloc((2 * step_count + 1) * sizeof(td_conv_t *));
     subdelay_filter = &subdelay_filter[step_count];
     filter = emalloc(subdelay_filter_length * realsize);
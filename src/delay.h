@@ -32,6 +32,11 @@ delay_subsample_update(void *buf,
                        void *rest,
                        int subdelay);
 
+/* returns a newly allocated copy of the subsample delay filter taps */
+void *
+delay_subsample_filter(int subdelay,
+                       int *n_taps);
+
 bool
 delay_subsample_init(int step_count,
                      int half_filter_length,
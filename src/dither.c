@@ -8,122 +8,167 @@
 #include <stdio.h>
 #include <string.h>
 #include <inttypes.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "dither.h"
 #include "emalloc.h"
-#include "pinfo.h"
-
-/* desired spacing between channels in random number table in seconds */
-#define RANDTAB_SPACING 10
-#define MIN_RANDTAB_SPACING 1
-
-int8_t *dither_randtab;
-int dither_randtab_size;
-void *dither_randmap = NULL;
 
 static int realsize;
 
 /*
  * From "Tables of maximally equidistributed combined LSFR generators" by L’Ecuyer.
  *
- * Generates pseudorandom numbers between 0x0 - 0xFFFFFFFF
+ * Generates pseudorandom numbers between 0x0 - 0xFFFFFFFF. Each dither state
+ * runs four generators side by side, so four numbers can be made at once
+ * with SIMD instructions.
  */
 static inline uint32_t
-lfsr113(uint32_t z[4])
+lfsr113(uint32_t z[4][4],
+        int i)
 {
     uint32_t b;
-    b = (((z[0] << 6u) ^ z[0]) >> 13u);
-    z[0] = (((z[0] & 4294967294u) << 18u) ^ b);
-    b = (((z[1] << 2u) ^ z[1]) >> 27u);
-    z[1] = (((z[1] & 4294967288u) << 2u) ^ b);
-    b = (((z[2] << 13u) ^ z[2]) >> 21u);
-    z[2] = (((z[2] & 4294967280u) << 7u) ^ b);
-    b = (((z[3] << 3u) ^ z[3]) >> 12u);
-    z[3] = (((z[3] & 4294967168u) << 13u) ^ b);
-    return (z[0] ^ z[1] ^ z[2] ^ z[3]);
+    b = (((z[0][i] << 6u) ^ z[0][i]) >> 13u);
+    z[0][i] = (((z[0][i] & 4294967294u) << 18u) ^ b);
+    b = (((z[1][i] << 2u) ^ z[1][i]) >> 27u);
+    z[1][i] = (((z[1][i] & 4294967288u) << 2u) ^ b);
+    b = (((z[2][i] << 13u) ^ z[2][i]) >> 21u);
+    z[2][i] = (((z[2][i] & 4294967280u) << 7u) ^ b);
+    b = (((z[3][i] << 3u) ^ z[3][i]) >> 12u);
+    z[3][i] = (((z[3][i] & 4294967168u) << 13u) ^ b);
+    return (z[0][i] ^ z[1][i] ^ z[2][i] ^ z[3][i]);
 }
 
-static void
-lfsr113_init(uint32_t state[4])
+#ifdef __SSE2__
+static inline __m128i
+lfsr113_x4(__m128i z[4])
 {
-    // The initial seeds z[0] - z [3]  MUST be larger than 1, 7, 15, and 127 respectively.
-    const uint32_t seed = 12345;
-    state[0] = seed;
-    state[1] = seed;
-    state[2] = seed;
-    state[3] = seed;
-    lfsr113(state);
-    lfsr113(state);
-    lfsr113(state);
-    lfsr113(state);
-    lfsr113(state);
-    lfsr113(state);
+    __m128i b;
+    b = _mm_srli_epi32(_mm_xor_si128(_mm_slli_epi32(z[0], 6), z[0]), 13);
+    z[0] = _mm_xor_si128(_mm_slli_epi32(_mm_and_si128(z[0], _mm_set1_epi32((int32_t)4294967294u)), 18), b);
+    b = _mm_srli_epi32(_mm_xor_si128(_mm_slli_epi32(z[1], 2), z[1]), 27);
+    z[1] = _mm_xor_si128(_mm_slli_epi32(_mm_and_si128(z[1], _mm_set1_epi32((int32_t)4294967288u)), 2), b);
+    b = _mm_srli_epi32(_mm_xor_si128(_mm_slli_epi32(z[2], 13), z[2]), 21);
+    z[2] = _mm_xor_si128(_mm_slli_epi32(_mm_and_si128(z[2], _mm_set1_epi32((int32_t)4294967280u)), 7), b);
+    b = _mm_srli_epi32(_mm_xor_si128(_mm_slli_epi32(z[3], 3), z[3]), 12);
+    z[3] = _mm_xor_si128(_mm_slli_epi32(_mm_and_si128(z[3], _mm_set1_epi32((int32_t)4294967168u)), 13), b);
+    return _mm_xor_si128(_mm_xor_si128(z[0], z[1]), _mm_xor_si128(z[2], z[3]));
 }
+#endif
 
-bool
-dither_init(const int n_channels,
-            const int sample_rate,
-            const int realsize_,
-            const int max_size,
-            const int max_samples_per_loop,
-            struct dither_state *dither_states[])
+/* scramble generator index to a seed, so that no two generators start with
+   simply related states */
+static uint32_t
+seed_hash(uint32_t x)
 {
-    realsize = realsize_;
+    x = (x + 1) * 0x9E3779B9u;
+    x ^= x >> 16;
+    x *= 0x85EBCA6Bu;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35u;
+    x ^= x >> 16;
+    return x;
+}
 
-    int spacing;
-    { // calculate spacing
-        int minspacing = MIN_RANDTAB_SPACING * sample_rate;
-        if (minspacing > max_samples_per_loop) {
-            minspacing = max_samples_per_loop;
-        }
-        spacing = RANDTAB_SPACING * sample_rate;
-        if (spacing < minspacing) {
-            spacing = minspacing;
-        }
-        if (max_size > 0 && n_channels * spacing > max_size) {
-            spacing = max_size / n_channels;
+static void
+lfsr113_init(uint32_t z[4][4],
+             int channel)
+{
+    // The initial seeds z[0] - z [3]  MUST be larger than 1, 7, 15, and 127 respectively.
+    for (int i = 0; i < 4; i++) {
+        for (int k = 0; k < 4; k++) {
+            z[k][i] = seed_hash((uint32_t)(16 * channel + 4 * i + k)) | 0x100u;
         }
-        if (spacing < minspacing) {
-            fprintf(stderr, "Maximum dither table size %d bytes is too small, must at least be %d bytes.\n",
-                    max_size, n_channels * sample_rate * minspacing);
-            return false;
+        for (int k = 0; k < 6; k++) {
+            lfsr113(z, i);
         }
     }
+}
 
-    dither_randtab_size = n_channels * spacing + 1;
+/*
+ * HP TPDF dither is the difference between two consecutive uniform random
+ * numbers, here ranging from -1.0 to +1.0, plus an offset of +0.5 used to
+ * make the sample truncation be mid-tread requantisation.
+ */
+#define RANDOM_SCALE (1.0 / 4294967296.0)
 
-    { // generate random number table
-        uint32_t state[4];
+void
+dither_preloop_real2int_hp_tpdf(struct dither_state *state,
+                                int samples_per_loop)
+{
+    int32_t r;
+    int n = 0;
 
-        pinfo("Dither table size is %d bytes.\n"
-              "Generating random numbers...", dither_randtab_size);
-        lfsr113_init(state);
-        dither_randtab = emallocaligned(dither_randtab_size);
-        for (int n = 0; n < dither_randtab_size; n++) {
-            dither_randtab[n] = (int8_t)(lfsr113(state) & 0x000000FF);
-        }
-        pinfo("finished.\n");
-    }
+#ifdef __SSE2__
+    __m128i z[4], cur, prev;
 
-    /* make a map for conversion of integer dither random numbers to
-       floating point ranging from -1.0 to +1.0, plus an offset of +0.5,
-       used to make the sample truncation be mid-tread requantisation */
-    dither_randmap = emallocaligned(realsize * 511);
-    dither_randmap = &((uint8_t *)dither_randmap)[255 * realsize];
+    for (int k = 0; k < 4; k++) {
+        z[k] = _mm_loadu_si128((__m128i *)state->z[k]);
+    }
+    prev = _mm_set1_epi32(state->prev_random);
     if (realsize == 4) {
-        for (int n = -255; n <= 255; n++) {
-            ((float *)dither_randmap)[n] = 0.5 + 1.0 / 255.0 * (float)n;
+        const __m128 scale = _mm_set1_ps((float)RANDOM_SCALE);
+        const __m128 half = _mm_set1_ps(0.5f);
+        float *noise = (float *)state->noise;
+        for (; n + 4 <= samples_per_loop; n += 4) {
+            cur = lfsr113_x4(z);
+            prev = _mm_or_si128(_mm_slli_si128(cur, 4), _mm_srli_si128(prev, 12));
+            _mm_storeu_ps(&noise[n],
+                          _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(cur),
+                                                           _mm_cvtepi32_ps(prev)),
+                                                scale), half));
+            prev = cur;
         }
     } else {
-        for (int n = -255; n <= 255; n++) {
-            ((double *)dither_randmap)[n] = 0.5 + 1.0 / 255.0 * (double)n;
+        const __m128d scale = _mm_set1_pd(RANDOM_SCALE);
+        const __m128d half = _mm_set1_pd(0.5);
+        double *noise = (double *)state->noise;
+        __m128i p;
+        for (; n + 4 <= samples_per_loop; n += 4) {
+            cur = lfsr113_x4(z);
+            p = _mm_or_si128(_mm_slli_si128(cur, 4), _mm_srli_si128(prev, 12));
+            _mm_storeu_pd(&noise[n],
+                          _mm_add_pd(_mm_mul_pd(_mm_sub_pd(_mm_cvtepi32_pd(cur),
+                                                           _mm_cvtepi32_pd(p)),
+                                                scale), half));
+            _mm_storeu_pd(&noise[n+2],
+                          _mm_add_pd(_mm_mul_pd(_mm_sub_pd(_mm_cvtepi32_pd(_mm_srli_si128(cur, 8)),
+                                                           _mm_cvtepi32_pd(_mm_srli_si128(p, 8))),
+                                                scale), half));
+            prev = cur;
+        }
+    }
+    for (int k = 0; k < 4; k++) {
+        _mm_storeu_si128((__m128i *)state->z[k], z[k]);
+    }
+    state->prev_random = _mm_cvtsi128_si32(_mm_srli_si128(prev, 12));
+#endif
+    for (; n < samples_per_loop; n++) {
+        r = (int32_t)lfsr113(state->z, n & 3);
+        if (realsize == 4) {
+            ((float *)state->noise)[n] =
+                (float)(((double)r - (double)state->prev_random) * RANDOM_SCALE + 0.5);
+        } else {
+            ((double *)state->noise)[n] =
+                ((double)r - (double)state->prev_random) * RANDOM_SCALE + 0.5;
         }
+        state->prev_random = r;
     }
+}
 
+void
+dither_init(const int n_channels,
+            const int realsize_,
+            const int max_samples_per_loop,
+            struct dither_state *dither_states[])
+{
+    realsize = realsize_;
     for (int n = 0; n < n_channels; n++) {
         dither_states[n] = emalloc(sizeof(struct dither_state));
         memset(dither_states[n], 0, sizeof(struct dither_state));
-        dither_states[n]->randtab_ptr = n * spacing + 1;
+        lfsr113_init(dither_states[n]->z, n);
+        dither_states[n]->noise = emallocaligned(max_samples_per_loop * realsize);
+        memset(dither_states[n]->noise, 0, max_samples_per_loop * realsize);
     }
-    return true;
 }
@@ -14,27 +14,18 @@
 #include "convolver.h"
 
 struct dither_state {
-    int randtab_ptr;
-    int8_t *randtab;
+    /* four interleaved lfsr113 generators, z[component][generator] */
+    uint32_t z[4][4];
+    int32_t prev_random;
+    void *noise; /* dither for the current block, +0.5 included */
     float sf[2];
     double sd[2];
 };
 
-extern int8_t *dither_randtab;
-extern int dither_randtab_size;
-extern void *dither_randmap;
-
-static inline void
+/* generate dither for the next block of samples */
+void
 dither_preloop_real2int_hp_tpdf(struct dither_state *state,
-                                int samples_per_loop)
-{
-    if (state->randtab_ptr + samples_per_loop >= dither_randtab_size) {
-        dither_randtab[0] = dither_randtab[state->randtab_ptr - 1];
-        state->randtab_ptr = 1;
-    }
-    state->randtab = &dither_randtab[state->randtab_ptr];
-    state->randtab_ptr += samples_per_loop;
-}
+                                int samples_per_loop);
 
 #define real_t float
 #define REALSIZE 4
@@ -56,11 +47,9 @@ dither_preloop_real2int_hp_tpdf(struct dither_state *state,
 #undef REALSIZE
 #undef real_t
 
-bool
+void
 dither_init(int n_channels,
-            int sample_rate,
             int realsize,
-            int max_size,
             int max_samples_per_loop,
             struct dither_state *dither_states[]);
 
@@ -27,9 +27,7 @@ REAL2INT_HP_TPDF_NAME(real_t real_sample,
 #endif
 
     /* apply dither and offset */
-    dithered_sample = real_sample +
-        ((real_t *)dither_randmap)[state->randtab[loop_counter] -
-                                  state->randtab[loop_counter - 1]];
+    dithered_sample = real_sample + ((real_t *)state->noise)[loop_counter];
 
     if (dithered_sample < 0) {
         if (dithered_sample <= rmin) {
@@ -618,3 +618,59 @@ DIRAC_CONVOLVE_NAME(void *input_cbuf,
     }
 }
 
+
+static void
+TD_MIXNSCALE_NAME(void *input_bufs[],
+                  void *output_buf,
+                  double scales[],
+                  int n_bufs,
+                  int n_samples)
+{
+    real_t **ibufs = (real_t **)input_bufs;
+    real_t *obuf = (real_t *)output_buf;
+    real_t s;
+    int n, i;
+
+    if (n_bufs == 0) {
+        memset(obuf, 0, n_samples * sizeof(real_t));
+        return;
+    }
+    s = (real_t)scales[0];
+    for (n = 0; n < n_samples; n++) {
+        obuf[n] = ibufs[0][n] * s;
+    }
+    for (i = 1; i < n_bufs; i++) {
+        s = (real_t)scales[i];
+        for (n = 0; n < n_samples; n++) {
+            obuf[n] += ibufs[i][n] * s;
+        }
+    }
+}
+
+static void
+TD_FIR_NAME(void *input_cbuf,
+            void *coeffs,
+            int n_coeffs,
+            double scale,
+            void *output_buf)
+{
+    real_t *x = &((real_t *)input_cbuf)[n_fft2];
+    real_t *h = (real_t *)coeffs;
+    real_t *y = (real_t *)output_buf;
+    real_t a0, a1, a2, a3, s = (real_t)scale;
+    int n, i;
+
+    for (n = 0; n < n_fft2; n += 4) {
+        a0 = a1 = a2 = a3 = 0;
+        for (i = 0; i < n_coeffs; i++) {
+            a0 += h[i] * x[n+0-i];
+            a1 += h[i] * x[n+1-i];
+            a2 += h[i] * x[n+2-i];
+            a3 += h[i] * x[n+3-i];
+        }
+        y[n+0] = a0 * s;
+        y[n+1] = a1 * s;
+        y[n+2] = a2 * s;
+        y[n+3] = a3 * s;
+    }
+}
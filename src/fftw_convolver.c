@@ -41,6 +41,7 @@ static int n_fft, n_fft2, fft_order;
 #define OPT_CODE_SSE   1
 #define OPT_CODE_SSE2  2
 static int opt_code;
+static int conv_opt_code; /* for sample format conversion */
 
 #if defined(ARCH_X86) || defined(ARCH_X86_64)
 static inline void
@@ -59,6 +60,7 @@ decide_opt_code(void)
     numunion_t vendor[2];
 
     opt_code = OPT_CODE_GCC;
+    conv_opt_code = OPT_CODE_GCC;
 
     vendor[1].u8[4] = '\0';
     cpuid(0x00000000, &level, &vendor->u32[0], &vendor->u32[2],
@@ -67,6 +69,10 @@ decide_opt_code(void)
         level >= 0x00000001)
     {
         cpuid(0x00000001, &junk, &junk, &junk, &cap);
+        if ((cap & (1 << 26)) != 0) {
+            /* conversion uses SSE2 integer instructions also for floats */
+            conv_opt_code = OPT_CODE_SSE2;
+        }
         if (realsize == 8) {
             if ((cap & (1 << 26)) != 0) {
                 opt_code = OPT_CODE_SSE2;
@@ -85,6 +91,62 @@ static void
 decide_opt_code(void)
 {
     opt_code = OPT_CODE_GCC;
+    conv_opt_code = OPT_CODE_GCC;
+}
+#endif
+
+#if defined(ARCH_X86) || defined(ARCH_X86_64)
+static uint32_t
+mxcsr_mask(void)
+{
+    uint8_t area[512 + 16], *fx;
+    uint32_t mask;
+
+    /* the MXCSR_MASK field of the fxsave area tells which bits are valid,
+       zero means the default mask which lacks denormals-are-zero */
+    fx = (uint8_t *)(((uintptr_t)area + 15) & ~(uintptr_t)15);
+    memset(fx, 0, 512);
+    __asm__ __volatile__ ("fxsave %0" : "=m" (*(uint8_t (*)[512])fx));
+    memcpy(&mask, &fx[28], sizeof(mask));
+    return mask == 0 ? 0xFFBF : mask;
+}
+
+bool
+convolver_flush_denormals(void)
+{
+    uint32_t level, junk, cap, mxcsr;
+
+    cpuid(0x00000000, &level, &junk, &junk, &junk);
+    if (level < 0x00000001) {
+        return false;
+    }
+    cpuid(0x00000001, &junk, &junk, &junk, &cap);
+    if ((cap & (1 << 25)) == 0 || (cap & (1 << 24)) == 0) {
+        /* no SSE or no fxsave */
+        return false;
+    }
+    __asm__ __volatile__ ("stmxcsr %0" : "=m" (mxcsr));
+    mxcsr |= 0x8000; /* flush-to-zero */
+    mxcsr |= 0x0040 & mxcsr_mask(); /* denormals-are-zero */
+    __asm__ __volatile__ ("ldmxcsr %0" : : "m" (mxcsr));
+    return true;
+}
+#elif defined(ARCH_ARM64)
+bool
+convolver_flush_denormals(void)
+{
+    uint64_t fpcr;
+
+    __asm__ __volatile__ ("mrs %0, fpcr" : "=r" (fpcr));
+    fpcr |= (uint64_t)1 << 24; /* flush-to-zero, also for inputs */
+    __asm__ __volatile__ ("msr fpcr, %0" : : "r" (fpcr));
+    return true;
+}
+#else
+bool
+convolver_flush_denormals(void)
+{
+    return false;
 }
 #endif
 
@@ -127,6 +189,8 @@ create_fft_plan(int length,
 #define CONVOLVE_ADD_NAME convolve_addf
 #define DIRAC_CONVOLVE_INPLACE_NAME dirac_convolve_inplacef
 #define DIRAC_CONVOLVE_NAME dirac_convolvef
+#define TD_MIXNSCALE_NAME td_mixnscalef
+#define TD_FIR_NAME td_firf
 #include "raw2real.h"
 #include "fftw_convfuns.h"
 #undef real_t
@@ -138,6 +202,8 @@ create_fft_plan(int length,
 #undef CONVOLVE_ADD_NAME
 #undef DIRAC_CONVOLVE_INPLACE_NAME
 #undef DIRAC_CONVOLVE_NAME
+#undef TD_MIXNSCALE_NAME
+#undef TD_FIR_NAME
 
 #define real_t double
 #define REALSIZE 8
@@ -148,6 +214,8 @@ create_fft_plan(int length,
 #define CONVOLVE_ADD_NAME convolve_addd
 #define DIRAC_CONVOLVE_INPLACE_NAME dirac_convolve_inplaced
 #define DIRAC_CONVOLVE_NAME dirac_convolved
+#define TD_MIXNSCALE_NAME td_mixnscaled
+#define TD_FIR_NAME td_fird
 #include "raw2real.h"
 #include "fftw_convfuns.h"
 #undef real_t
@@ -159,6 +227,22 @@ create_fft_plan(int length,
 #undef CONVOLVE_ADD_NAME
 #undef DIRAC_CONVOLVE_INPLACE_NAME
 #undef DIRAC_CONVOLVE_NAME
+#undef TD_MIXNSCALE_NAME
+#undef TD_FIR_NAME
+
+/*
+ * Samples are already in the internal format, non-interleaved. Such blocks
+ * are still copied once between the I/O buffer and the filter buffer: the
+ * I/O buffers are shared with the input and output processes, and are
+ * refilled while the filter works, and the FFT and IFFT work on transform
+ * length buffers, so they cannot alias the I/O buffer.
+ */
+static inline bool
+is_native_format(const struct buffer_format *bf)
+{
+    return bf->sf.isfloat && !bf->sf.swap && bf->sf.bytes == realsize &&
+        bf->sample_spacing == 1;
+}
 
 void
 convolver_raw2cbuf(void *rawbuf,
@@ -170,20 +254,48 @@ convolver_raw2cbuf(void *rawbuf,
                                        void *arg),
                    void *pp_arg)
 {
-    if (realsize == 4) {
-        raw2realf(next_cbuf, (void *)&((uint8_t *)rawbuf)[bf->byte_offset],
-                  bf->sf.bytes,
-                  bf->sf.isfloat, bf->sample_spacing, bf->sf.swap, n_fft2);
-    } else {
-        raw2reald(next_cbuf, (void *)&((uint8_t *)rawbuf)[bf->byte_offset],
-                  bf->sf.bytes,
-                  bf->sf.isfloat, bf->sample_spacing, bf->sf.swap, n_fft2);
+    uint8_t *raw = &((uint8_t *)rawbuf)[bf->byte_offset];
+    int n = 0;
+
+    if (is_native_format(bf)) {
+        /* nothing to convert */
+        memcpy(next_cbuf, raw, n_fft2 * realsize);
+        n = n_fft2;
+    }
+#ifdef __SSE2__
+    if (n == 0 && conv_opt_code == OPT_CODE_SSE2) {
+        if (realsize == 4) {
+            n = convolver_sse2_raw2realf(next_cbuf, raw, bf->sf.bytes,
+                                         bf->sf.isfloat, bf->sample_spacing,
+                                         bf->sf.swap, n_fft2);
+        } else {
+            n = convolver_sse2_raw2reald(next_cbuf, raw, bf->sf.bytes,
+                                         bf->sf.isfloat, bf->sample_spacing,
+                                         bf->sf.swap, n_fft2);
+        }
+    }
+#endif
+    /* the generic code converts what is left, or everything */
+    if (n < n_fft2) {
+        raw += n * bf->sf.bytes * bf->sample_spacing;
+        if (realsize == 4) {
+            raw2realf(&((float *)next_cbuf)[n], raw, bf->sf.bytes,
+                      bf->sf.isfloat, bf->sample_spacing, bf->sf.swap,
+                      n_fft2 - n);
+        } else {
+            raw2reald(&((double *)next_cbuf)[n], raw, bf->sf.bytes,
+                      bf->sf.isfloat, bf->sample_spacing, bf->sf.swap,
+                      n_fft2 - n);
+        }
     }
     if (postprocess != NULL) {
         postprocess(next_cbuf, n_fft2, pp_arg);
     }
 
-    memcpy(&((uint8_t *)cbuf)[n_fft2 * realsize], next_cbuf, n_fft2 * realsize);
+    if (&((uint8_t *)cbuf)[n_fft2 * realsize] != next_cbuf) {
+        memcpy(&((uint8_t *)cbuf)[n_fft2 * realsize], next_cbuf,
+               n_fft2 * realsize);
+    }
 }
 
 void
@@ -321,39 +433,107 @@ convolver_convolve_add(void *input_cbuf,
 }
 
 void
-convolver_crossfade_inplace(void *input_cbuf,
-                            void *crossfade_cbuf,
-                            void *buffer_cbuf)
+convolver_crossfade_time(void *from_cbuf,
+                         void *to_cbuf)
 {
-    void *buf1, *buf2;
-    double scale, d;
+    double d;
     float f;
     int n;
 
-    buf1 = buffer_cbuf;
-    buf2 = &((uint8_t *)buffer_cbuf)[n_fft * realsize];
-    scale = 1.0;
-    convolver_mixnscale(&crossfade_cbuf, buffer_cbuf, &scale, 1,
-                        CONVOLVER_MIXMODE_OUTPUT);
-    convolver_freq2time(buffer_cbuf, crossfade_cbuf);
-    convolver_mixnscale(&input_cbuf, buffer_cbuf, &scale, 1,
-                        CONVOLVER_MIXMODE_OUTPUT);
-    convolver_freq2time(buffer_cbuf, buffer_cbuf);
     if (realsize == 4) {
         f = 1.0 / (float)(n_fft2 - 1);
         for (n = 0; n < n_fft2; n++) {
-            ((float *)buffer_cbuf)[n] =
-                ((float *)crossfade_cbuf)[n] * (1.0 - f * (float)n) +
-                ((float *)buffer_cbuf)[n] * f * (float)n;
+            ((float *)to_cbuf)[n] =
+                ((float *)from_cbuf)[n] * (1.0 - f * (float)n) +
+                ((float *)to_cbuf)[n] * f * (float)n;
         }
     } else {
         d = 1.0 / (double)(n_fft2 - 1);
         for (n = 0; n < n_fft2; n++) {
-            ((double *)buf1)[n] =
-                ((double *)buf1)[n] * (1.0 - d * (double)n) +
-                ((double *)buf2)[n] * d * (double)n;
+            ((double *)to_cbuf)[n] =
+                ((double *)from_cbuf)[n] * (1.0 - d * (double)n) +
+                ((double *)to_cbuf)[n] * d * (double)n;
+        }
+    }
+}
+
+void
+convolver_td_mixnscale(void *input_bufs[],
+                       void *output_buf,
+                       double scales[],
+                       int n_bufs,
+                       int n_samples)
+{
+    if (n_bufs == 0) {
+        memset(output_buf, 0, n_samples * realsize);
+        return;
+    }
+    switch (opt_code) {
+#ifdef __SSE__
+    case OPT_CODE_SSE:
+        convolver_sse_td_mixnscale(input_bufs, output_buf, scales, n_bufs, n_samples);
+        break;
+#ifdef __SSE2__
+    case OPT_CODE_SSE2:
+        convolver_sse2_td_mixnscale(input_bufs, output_buf, scales, n_bufs, n_samples);
+        break;
+#endif
+#endif
+    default:
+    case OPT_CODE_GCC:
+        if (realsize == 4) {
+            td_mixnscalef(input_bufs, output_buf, scales, n_bufs, n_samples);
+        } else {
+            td_mixnscaled(input_bufs, output_buf, scales, n_bufs, n_samples);
+        }
+    }
+}
+
+void
+convolver_td_fir(void *input_cbuf,
+                 void *coeffs,
+                 int n_coeffs,
+                 double scale,
+                 void *output_buf)
+{
+    switch (opt_code) {
+#ifdef __SSE__
+    case OPT_CODE_SSE:
+        convolver_sse_td_fir(&((float *)input_cbuf)[n_fft2], coeffs, n_coeffs,
+                             (float)scale, output_buf, n_fft2);
+        break;
+#ifdef __SSE2__
+    case OPT_CODE_SSE2:
+        convolver_sse2_td_fir(&((double *)input_cbuf)[n_fft2], coeffs,
+                              n_coeffs, scale, output_buf, n_fft2);
+        break;
+#endif
+#endif
+    default:
+    case OPT_CODE_GCC:
+        if (realsize == 4) {
+            td_firf(input_cbuf, coeffs, n_coeffs, scale, output_buf);
+        } else {
+            td_fird(input_cbuf, coeffs, n_coeffs, scale, output_buf);
         }
     }
+}
+
+void
+convolver_crossfade_inplace(void *input_cbuf,
+                            void *crossfade_cbuf,
+                            void *buffer_cbuf)
+{
+    double scale;
+
+    scale = 1.0;
+    convolver_mixnscale(&crossfade_cbuf, buffer_cbuf, &scale, 1,
+                        CONVOLVER_MIXMODE_OUTPUT);
+    convolver_freq2time(buffer_cbuf, crossfade_cbuf);
+    convolver_mixnscale(&input_cbuf, buffer_cbuf, &scale, 1,
+                        CONVOLVER_MIXMODE_OUTPUT);
+    convolver_freq2time(buffer_cbuf, buffer_cbuf);
+    convolver_crossfade_time(crossfade_cbuf, buffer_cbuf);
     convolver_time2freq(buffer_cbuf, buffer_cbuf);
     scale = 1.0 / (double)n_fft;
     convolver_mixnscale(&buffer_cbuf, input_cbuf, &scale, 1,
@@ -430,8 +610,9 @@ convolver_convolve_eval(void *input_cbuf,
 #define REAL2RAW_NAME real2rawf_hp_tpdf
 #define REAL2INT_CALL ditherf_real2int_hp_tpdf(((float *)realbuf)[n], rmin,    \
                                                rmax, imin, imax, overflow,     \
-                                               dither_state, n)
-#define REAL2RAW_EXTRA_PARAMS , struct dither_state *dither_state
+                                               dither_state, n + noise_offset)
+#define REAL2RAW_EXTRA_PARAMS , struct dither_state *dither_state,             \
+                              int noise_offset
 #include "real2raw.h"
 #undef REAL2RAW_NAME
 #undef REAL2INT_CALL
@@ -453,8 +634,9 @@ convolver_convolve_eval(void *input_cbuf,
 #define REAL2RAW_NAME real2rawd_hp_tpdf
 #define REAL2INT_CALL ditherd_real2int_hp_tpdf(((double *)realbuf)[n], rmin,   \
                                                rmax, imin, imax, overflow,     \
-                                               dither_state, n)
-#define REAL2RAW_EXTRA_PARAMS , struct dither_state *dither_state
+                                               dither_state, n + noise_offset)
+#define REAL2RAW_EXTRA_PARAMS , struct dither_state *dither_state,             \
+                              int noise_offset
 #include "real2raw.h"
 #undef REAL2RAW_NAME
 #undef REAL2INT_CALL
@@ -472,6 +654,118 @@ convolver_convolve_eval(void *input_cbuf,
 #undef real_t
 
 
+/* scan for the largest absolute value and denormals, returns early on NaN */
+static void
+output_scan(const void *cbuf,
+            int n_samples,
+            double *peak,
+            bool *denormal)
+{
+    double a;
+    int n;
+
+    for (n = 0; n < n_samples; n++) {
+        if (realsize == 4) {
+            a = (double)fabsf(((const float *)cbuf)[n]);
+            if (fpclassify(((const float *)cbuf)[n]) == FP_SUBNORMAL) {
+                *denormal = true;
+            }
+        } else {
+            a = fabs(((const double *)cbuf)[n]);
+            if (fpclassify(a) == FP_SUBNORMAL) {
+                *denormal = true;
+            }
+        }
+        if (!(a <= *peak)) {
+            *peak = a;
+            if (isnan(a)) {
+                return;
+            }
+        }
+    }
+}
+
+static unsigned int
+count_overflows(const void *cbuf,
+                int n_samples,
+                double max)
+{
+    unsigned int count = 0;
+    int n;
+
+    for (n = 0; n < n_samples; n++) {
+        if (realsize == 4) {
+            count += fabs((double)((const float *)cbuf)[n]) > max;
+        } else {
+            count += fabs(((const double *)cbuf)[n]) > max;
+        }
+    }
+    return count;
+}
+
+static void
+output_safety_test(double peak,
+                   struct bfoverflow *overflow)
+{
+    if (bfconf->safety_limit != 0.0 &&
+        peak > bfconf->safety_limit * overflow->max)
+    {
+        fprintf(stderr, "Safety limit exceeded on output (%.2f > %.2f). "
+                "Aborting.\n",
+                20.0 * log10(peak / overflow->max),
+                20.0 * log10(bfconf->safety_limit));
+        bf_exit(BF_EXIT_OTHER);
+    }
+}
+
+static int
+cbuf2raw_simd(void *cbuf,
+              uint8_t *raw,
+              struct buffer_format *bf,
+              struct dither_state *dither_state,
+              struct bfoverflow *overflow,
+              double *peak,
+              bool *denormal)
+{
+    int n = 0, den = 0;
+
+    switch (conv_opt_code) {
+#ifdef __SSE2__
+    case OPT_CODE_SSE2:
+        if (dither_state != NULL) {
+            if (realsize == 4) {
+                n = convolver_sse2_real2rawf_hp_tpdf(
+                    raw, cbuf, bf->sf.sbytes << 3, bf->sf.bytes,
+                    bf->sample_spacing, bf->sf.swap, n_fft2,
+                    (const float *)dither_state->noise, dither_state->sf,
+                    overflow, peak, &den);
+            } else {
+                n = convolver_sse2_real2rawd_hp_tpdf(
+                    raw, cbuf, bf->sf.sbytes << 3, bf->sf.bytes,
+                    bf->sample_spacing, bf->sf.swap, n_fft2,
+                    (const double *)dither_state->noise, dither_state->sd,
+                    overflow, peak, &den);
+            }
+        } else if (realsize == 4) {
+            n = convolver_sse2_real2rawf(raw, cbuf, bf->sf.sbytes << 3,
+                                         bf->sf.bytes, bf->sf.isfloat,
+                                         bf->sample_spacing, bf->sf.swap,
+                                         n_fft2, overflow, peak, &den);
+        } else {
+            n = convolver_sse2_real2rawd(raw, cbuf, bf->sf.sbytes << 3,
+                                         bf->sf.bytes, bf->sf.isfloat,
+                                         bf->sample_spacing, bf->sf.swap,
+                                         n_fft2, overflow, peak, &den);
+        }
+        break;
+#endif
+    default:
+        break;
+    }
+    *denormal = den != 0;
+    return n;
+}
+
 void
 convolver_cbuf2raw(void *cbuf,
                    void *outbuf,
@@ -480,32 +774,81 @@ convolver_cbuf2raw(void *cbuf,
                    void *dither_state,
                    struct bfoverflow *overflow)
 {
+    struct bfoverflow of = *overflow;
+    struct dither_state *ds = dither_state;
+    void *raw = &((uint8_t *)outbuf)[bf->byte_offset];
+    bool denormal = false;
+    double peak = 0.0;
+    int n;
+
+    if (bf->sf.isfloat) {
+        apply_dither = false;
+    }
+    if (apply_dither) {
+        dither_preloop_real2int_hp_tpdf(ds, n_fft2);
+    }
+    /* the vectorised code converts and scans what it can, the generic code
+       the rest, which is scanned before it is converted */
+    n = cbuf2raw_simd(cbuf, raw, bf, apply_dither ? ds : NULL, overflow,
+                      &peak, &denormal);
+    if (n < n_fft2 && !isnan(peak)) {
+        output_scan(&((uint8_t *)cbuf)[n * realsize], n_fft2 - n, &peak,
+                    &denormal);
+    }
+    if (!isfinite(peak)) {
+        /* NaN or Inf, from invalid input or unstable processing. The block
+           is counted and replaced with silence rather than aborting, and the
+           error feedback is cleared so it does not get stuck on NaN */
+        *overflow = of;
+        overflow->n_nonfinite++;
+        if (apply_dither) {
+            ds->sf[0] = ds->sf[1] = 0.0f;
+            ds->sd[0] = ds->sd[1] = 0.0;
+        }
+        memset(cbuf, 0, n_fft2 * realsize);
+        convolver_cbuf2raw(cbuf, outbuf, bf, false, NULL, overflow);
+        return;
+    }
+    if (denormal) {
+        overflow->n_denormals++;
+    }
+    output_safety_test(peak, overflow);
+    if (n == n_fft2) {
+        return;
+    }
+    if (n == 0 && is_native_format(bf)) {
+        /* the scan above was the only pass needed, the rest is a copy */
+        if (peak > overflow->max) {
+            overflow->n_overflows += count_overflows(cbuf, n_fft2,
+                                                     overflow->max);
+        }
+        if (peak > overflow->largest) {
+            overflow->largest = peak;
+        }
+        memcpy(raw, cbuf, n_fft2 * realsize);
+        return;
+    }
+    raw = &((uint8_t *)raw)[n * bf->sf.bytes * bf->sample_spacing];
+    cbuf = &((uint8_t *)cbuf)[n * realsize];
     if (realsize == 4) {
-        if (apply_dither && !bf->sf.isfloat) {
-            dither_preloop_real2int_hp_tpdf(dither_state, n_fft2);
-            real2rawf_hp_tpdf((void *)&((uint8_t *)outbuf)[bf->byte_offset],
-                              cbuf, bf->sf.sbytes << 3, bf->sf.bytes,
+        if (apply_dither) {
+            real2rawf_hp_tpdf(raw, cbuf, bf->sf.sbytes << 3, bf->sf.bytes,
                               bf->sf.isfloat, bf->sample_spacing,
-                              bf->sf.swap, n_fft2, overflow, dither_state);
+                              bf->sf.swap, n_fft2 - n, overflow, ds, n);
         } else {
-            real2rawf_no_dither((void *)&((uint8_t *)outbuf)[bf->byte_offset],
-                                cbuf, bf->sf.sbytes << 3, bf->sf.bytes,
+            real2rawf_no_dither(raw, cbuf, bf->sf.sbytes << 3, bf->sf.bytes,
                                 bf->sf.isfloat, bf->sample_spacing,
-                                bf->sf.swap, n_fft2, overflow);
+                                bf->sf.swap, n_fft2 - n, overflow);
         }
     } else {
-        if (apply_dither && !bf->sf.isfloat) {
-            dither_preloop_real2int_hp_tpdf(dither_state, n_fft2);
-            real2rawd_hp_tpdf((void *)&((uint8_t *)outbuf)[bf->byte_offset],
-                              cbuf, bf->sf.sbytes << 3, bf->sf.bytes,
+        if (apply_dither) {
+            real2rawd_hp_tpdf(raw, cbuf, bf->sf.sbytes << 3, bf->sf.bytes,
                               bf->sf.isfloat, bf->sample_spacing,
-                              bf->sf.swap, n_fft2, overflow, dither_state);
+                              bf->sf.swap, n_fft2 - n, overflow, ds, n);
         } else {
-            real2rawd_no_dither((void *)&((uint8_t *)outbuf)[bf->byte_offset],
-                                cbuf, bf->sf.sbytes << 3,
-                                bf->sf.bytes,
+            real2rawd_no_dither(raw, cbuf, bf->sf.sbytes << 3, bf->sf.bytes,
                                 bf->sf.isfloat, bf->sample_spacing,
-                                bf->sf.swap, n_fft2, overflow);
+                                bf->sf.swap, n_fft2 - n, overflow);
         }
     }
 }
@@ -787,6 +1130,94 @@ convolver_td_convolve(td_conv_t *tdc,
     }
 }
 
+void *
+convolver_part_coeffs2cbuf(void *coeffs,
+                           int n_coeffs,
+                           double scale,
+                           int blocklen)
+{
+    void *cbuf;
+    int n;
+
+    /* coefficients are put in the second half, so the valid output ends up
+       in the first half, as with the other convolver functions */
+    cbuf = emallocaligned(2 * blocklen * realsize);
+    memset(cbuf, 0, 2 * blocklen * realsize);
+    if (n_coeffs > blocklen) {
+        n_coeffs = blocklen;
+    }
+    if (realsize == 4) {
+        for (n = 0; n < n_coeffs; n++) {
+            ((float *)cbuf)[blocklen + n] =
+                (float)(((float *)coeffs)[n] * scale / (double)(blocklen << 1));
+        }
+    } else {
+        for (n = 0; n < n_coeffs; n++) {
+            ((double *)cbuf)[blocklen + n] =
+                ((double *)coeffs)[n] * scale / (double)(blocklen << 1);
+        }
+    }
+    convolver_part_time2freq(cbuf, blocklen);
+    return cbuf;
+}
+
+void
+convolver_part_time2freq(void *cbuf,
+                         int blocklen)
+{
+    void *fftplan = convolver_fftplan(log2_get(blocklen) + 1, false, true);
+
+    if (realsize == 4) {
+        fftwf_execute_r2r(fftplan, cbuf, cbuf);
+    } else {
+        fftw_execute_r2r(fftplan, cbuf, cbuf);
+    }
+}
+
+void
+convolver_part_convolve_add(void *input_cbuf,
+                            void *coeffs,
+                            void *output_cbuf,
+                            int blocklen)
+{
+    int n, size = blocklen << 1;
+
+    if (realsize == 4) {
+        float *a = (float *)input_cbuf, *c = (float *)coeffs;
+        float *d = (float *)output_cbuf;
+
+        d[0] += a[0] * c[0];
+        for (n = 1; n < blocklen; n++) {
+            d[n] += a[n] * c[n] - a[size - n] * c[size - n];
+            d[size - n] += a[n] * c[size - n] + a[size - n] * c[n];
+        }
+        d[blocklen] += a[blocklen] * c[blocklen];
+    } else {
+        double *a = (double *)input_cbuf, *c = (double *)coeffs;
+        double *d = (double *)output_cbuf;
+
+        d[0] += a[0] * c[0];
+        for (n = 1; n < blocklen; n++) {
+            d[n] += a[n] * c[n] - a[size - n] * c[size - n];
+            d[size - n] += a[n] * c[size - n] + a[size - n] * c[n];
+        }
+        d[blocklen] += a[blocklen] * c[blocklen];
+    }
+}
+
+void
+convolver_part_freq2time(void *cbuf,
+                         int blocklen)
+{
+    void *ifftplan = convolver_fftplan(log2_get(blocklen) + 1, true, true);
+
+    if (realsize == 4) {
+        fftwf_execute_r2r(ifftplan, cbuf, cbuf);
+    } else {
+        fftw_execute_r2r(ifftplan, cbuf, cbuf);
+    }
+}
+
 bool
 convolver_init(const char config_filename[],
                int length,
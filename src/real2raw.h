@@ -15,32 +15,6 @@
  #error invalid REALSIZE
 #endif
 
-#ifndef CONCAT_EVAL_
-#define CONCAT_EVAL_(a, b) a ## b
-#define CONCAT_(a, b) CONCAT_EVAL_(a, b)
-#endif
-#define REAL2RAW_SAMPLE_TEST CONCAT_(REAL2RAW_NAME, _sample_test)
-
-static inline void
-REAL2RAW_SAMPLE_TEST(REAL_T real_sample, struct bfoverflow *overflow)
-{
-    if (!isfinite(real_sample)) {
-        fprintf(stderr, "NaN or Inf values in the output! Bad output. "
-                        "Aborting.\n");
-        abort();
-    }
-    if (bfconf->safety_limit != 0.0 &&
-        (real_sample < -bfconf->safety_limit * overflow->max ||
-         real_sample > bfconf->safety_limit * overflow->max))
-    {
-        fprintf(stderr, "Safety limit exceeded on output (%.2f > %.2f). "
-                "Aborting.\n",
-                20.0 * log10(fabs(real_sample / overflow->max)),
-                20.0 * log10(bfconf->safety_limit));
-        bf_exit(BF_EXIT_OTHER);
-    }
-}
-
 #define REAL_OVERFLOW_UPDATE                                                   \
     if (realbuf->RXX[n] < 0.0) {                                               \
         if (realbuf->RXX[n] < rmin) {                                          \
@@ -89,13 +63,11 @@ REAL2RAW_NAME(void *_rawbuf,
         case 4:
             if (swap) {
                 for (n = i = 0; n < n_samples; n++, i += spacing) {
-                    REAL2RAW_SAMPLE_TEST(realbuf->RXX[n], overflow);
                     REAL_OVERFLOW_UPDATE;
                     rawbuf->u32[i] = bit32_swap(realbuf->u32[n]);
                 }
             } else {
                 for (n = i = 0; n < n_samples; n++, i += spacing) {
-                    REAL2RAW_SAMPLE_TEST(realbuf->RXX[n], overflow);
                     REAL_OVERFLOW_UPDATE;
                     rawbuf->r32[i] = realbuf->r32[n];
                 }
@@ -104,14 +76,12 @@ REAL2RAW_NAME(void *_rawbuf,
         case 8:
             if (swap) {
                 for (n = i = 0; n < n_samples; n++, i += spacing) {
-                    REAL2RAW_SAMPLE_TEST(realbuf->RXX[n], overflow);
                     REAL_OVERFLOW_UPDATE;
                     sample.r64[0] = (double)realbuf->r32[n];
                     rawbuf->u64[i] = bit64_swap(sample.u64[0]);
                 }
             } else {
                 for (n = i = 0; n < n_samples; n++, i += spacing) {
-                    REAL2RAW_SAMPLE_TEST(realbuf->RXX[n], overflow);
                     REAL_OVERFLOW_UPDATE;
                     rawbuf->r64[i] = (double)realbuf->r32[n];
                 }
@@ -125,14 +95,12 @@ REAL2RAW_NAME(void *_rawbuf,
         case 4:
             if (swap) {
                 for (n = i = 0; n < n_samples; n++, i += spacing) {
-                    REAL2RAW_SAMPLE_TEST(realbuf->RXX[n], overflow);
                     REAL_OVERFLOW_UPDATE;
                     sample.r32[0] = (float)realbuf->r64[n];
                     rawbuf->u32[i] = bit32_swap(sample.u32[0]);
                 }
             } else {
                 for (n = i = 0; n < n_samples; n++, i += spacing) {
-                    REAL2RAW_SAMPLE_TEST(realbuf->RXX[n], overflow);
                     REAL_OVERFLOW_UPDATE;
                     rawbuf->r32[i] = (float)realbuf->r64[n];
                 }
@@ -141,13 +109,11 @@ REAL2RAW_NAME(void *_rawbuf,
         case 8:
             if (swap) {
                 for (n = i = 0; n < n_samples; n++, i += spacing) {
-                    REAL2RAW_SAMPLE_TEST(realbuf->RXX[n], overflow);
                     REAL_OVERFLOW_UPDATE;
                     rawbuf->u64[i] = bit64_swap(realbuf->u64[n]);
                 }
             } else {
                 for (n = i = 0; n < n_samples; n++, i += spacing) {
-                    REAL2RAW_SAMPLE_TEST(realbuf->RXX[n], overflow);
                     REAL_OVERFLOW_UPDATE;
                     rawbuf->r64[i] = realbuf->r64[n];
                 }
@@ -169,20 +135,17 @@ REAL2RAW_NAME(void *_rawbuf,
     switch (bytes) {
     case 1:
         for (n = i = 0; n < n_samples; n++, i += spacing) {
-            REAL2RAW_SAMPLE_TEST(realbuf->RXX[n], overflow);
             rawbuf->i8[i] = (int8_t)REAL2INT_CALL;
         }
         break;
     case 2:
         if (swap) {
             for (n = i = 0; n < n_samples; n++, i += spacing) {
-                REAL2RAW_SAMPLE_TEST(realbuf->RXX[n], overflow);
                 sample.i16[0] = (int16_t)REAL2INT_CALL;
                 rawbuf->u16[i] = bit16_swap(sample.u16[0]);
             }
         } else {
             for (n = i = 0; n < n_samples; n++, i += spacing) {
-                REAL2RAW_SAMPLE_TEST(realbuf->RXX[n], overflow);
                 rawbuf->i16[i] = (int16_t)REAL2INT_CALL;
             }
         }
@@ -192,7 +155,6 @@ REAL2RAW_NAME(void *_rawbuf,
 #ifdef ARCH_BIG_ENDIAN
         if (swap) {
             for (n = i = 0; n < n_samples; n++, i += spacing) {
-                REAL2RAW_SAMPLE_TEST(realbuf->RXX[n], overflow);
                 sample.i32[0] = REAL2INT_CALL;
                 rawbuf->u8[i++] = sample.u8[3];
                 rawbuf->u8[i++] = sample.u8[2];
@@ -200,7 +162,6 @@ REAL2RAW_NAME(void *_rawbuf,
             }
         } else {
             for (n = i = 0; n < n_samples; n++, i += spacing) {
-                REAL2RAW_SAMPLE_TEST(realbuf->RXX[n], overflow);
                 sample.i32[0] = REAL2INT_CALL;
                 rawbuf->u8[i++] = sample.u8[1];
                 rawbuf->u8[i++] = sample.u8[2];
@@ -211,7 +172,6 @@ REAL2RAW_NAME(void *_rawbuf,
 #ifdef ARCH_LITTLE_ENDIAN
         if (swap) {
             for (n = i = 0; n < n_samples; n++, i += spacing) {
-                REAL2RAW_SAMPLE_TEST(realbuf->RXX[n], overflow);
                 sample.i32[0] = REAL2INT_CALL;
                 rawbuf->u8[i++] = sample.u8[2];
                 rawbuf->u8[i++] = sample.u8[1];
@@ -219,7 +179,6 @@ REAL2RAW_NAME(void *_rawbuf,
             }
         } else {
             for (n = i = 0; n < n_samples; n++, i += spacing) {
-                REAL2RAW_SAMPLE_TEST(realbuf->RXX[n], overflow);
                 sample.i32[0] = REAL2INT_CALL;
                 rawbuf->u8[i++] = sample.u8[0];
                 rawbuf->u8[i++] = sample.u8[1];
@@ -231,13 +190,11 @@ REAL2RAW_NAME(void *_rawbuf,
     case 4:
         if (swap) {
             for (n = i = 0; n < n_samples; n++, i += spacing) {
-                REAL2RAW_SAMPLE_TEST(realbuf->RXX[n], overflow);
                 sample.i32[0] = REAL2INT_CALL;
                 rawbuf->u32[i] = bit32_swap(sample.u32[0]);
             }
         } else {
             for (n = i = 0; n < n_samples; n++, i += spacing) {
-                REAL2RAW_SAMPLE_TEST(realbuf->RXX[n], overflow);
                 rawbuf->i32[i] = REAL2INT_CALL;
             }
         }